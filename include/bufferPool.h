@@ -0,0 +1,57 @@
+#pragma once
+
+#include "defines.h"
+#include "lockFreeQueue.h"
+#include <array>
+#include <atomic>
+#include <vector>
+#include <switch.h>
+
+namespace BufferPool {
+	/**
+	 * @brief Response buffers recycled between the threads that build responses and the sender thread that frees them,
+	 * so steady-state commands stop allocating on the fixed newlib heap. Buffers are kept in a few size classes
+	 * and the total kept is capped, so the pool can't hold more than a fixed slice of the heap.
+	 */
+	class Pool {
+	public:
+		static Pool& instance() {
+			static Pool poolInstance;
+			return poolInstance;
+		}
+
+		struct Stats {
+			u64 hits;
+			u64 misses;
+			u64 drops;
+			u64 pooledBytes;
+			u64 peakBytes;
+		};
+
+		std::vector<char> acquire(size_t size = 0);
+		void release(std::vector<char>&& buffer);
+		void reserve(std::vector<char>& buffer, size_t size);
+		Stats getStats() const;
+
+	private:
+		Pool() {}
+		~Pool() {}
+
+		Pool(const Pool&) = delete;
+		Pool& operator=(const Pool&) = delete;
+
+		static constexpr std::array<size_t, 4> ClassSizes = { 0x100, 0x1000, 0x10000, 0x40000 };
+		static constexpr size_t ClassDepth = 16; // Free buffers kept per class.
+		static constexpr size_t MaxPooledBytes = 0x80000; // Cap on capacity held by free buffers across all classes.
+
+		static int classForSize(size_t size);
+		static int classForCapacity(size_t capacity);
+
+		std::array<LocklessQueue::LockFreeQueue<std::vector<char>, ClassDepth>, ClassSizes.size()> m_free;
+		std::atomic<u64> m_hits { 0 };
+		std::atomic<u64> m_misses { 0 };
+		std::atomic<u64> m_drops { 0 };
+		std::atomic<u64> m_pooledBytes { 0 };
+		std::atomic<u64> m_peakBytes { 0 };
+	};
+}
@@ -3,130 +3,138 @@
 #include "defines.h"
 #include "controllerCommands.h"
 #include "memoryCommands.h"
-#include <functional>
+#include "scanCommands.h"
+#include "watchCommands.h"
+#include "compression.h"
+#include "protocol.h"
+#include "dispatch.h"
+#include "commandLanes.h"
+#include "priorityQueue.h"
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
+// Each macro expands to one dispatch table entry. The tables themselves are built at compile time in commandHandler.cpp.
 #define REGISTER_CMD(name, function) \
-    (m_cmd)[(name)] = [this](const std::vector<std::string>& params, std::vector<char>& buffer) { this->function(params, buffer); }
+    { (name), [](Handler& self, Args params, std::vector<char>& buffer) { self.function(params, buffer); } }
 #define REGISTER_CMD_BUFFER(name, function) \
-    (m_cmd)[(name)] = [this](const std::vector<std::string>&, std::vector<char>& buffer) { this->function(buffer); }
+    { (name), [](Handler& self, Args, std::vector<char>& buffer) { self.function(buffer); } }
 #define REGISTER_CMD_PARAMS(name, function) \
-    (m_cmd)[(name)] = [this](const std::vector<std::string>& params, std::vector<char>&) { this->function(params); }
+    { (name), [](Handler& self, Args params, std::vector<char>&) { self.function(params); } }
 #define REGISTER_CMD_NOARGS(name, function) \
-    (m_cmd)[(name)] = [this](const std::vector<std::string>&, std::vector<char>&) { this->function(); }
-
-using CmdFunc = std::function<void(const std::vector<std::string>&, std::vector<char>&)>;
+    { (name), [](Handler& self, Args, std::vector<char>&) { self.function(); } }
+#define REGISTER_BENCH_CMD(name, function) \
+    { (name), [](Handler& self, Args params, std::vector<char>& buffer) { self.function(params, buffer); } }
+#define REGISTER_STATS_CMD(name, function) \
+    { (name), [](Handler& self, std::vector<char>& buffer) { self.function(buffer); } }
+#define REGISTER_FRAME_CMD(opcode, function) \
+    { (opcode), [](Handler& self, const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload) { return self.function(header, args, payload); } }
 
 namespace CommandHandler {
-	class Handler : public ControllerCommands::Controller, protected MemoryCommands::Vision {
-	public:
-		Handler() : Controller() {
-#pragma region Register
-			REGISTER_CMD("peek", peek_cmd);
-			REGISTER_CMD("peekMulti", peekMulti_cmd);
-			REGISTER_CMD("peekAbsolute", peekAbsolute_cmd);
-			REGISTER_CMD("peekAbsoluteMulti", peekAbsoluteMulti_cmd);
-			REGISTER_CMD("peekMain", peekMain_cmd);
-			REGISTER_CMD("peekMainMulti", peekMainMulti_cmd);
-
-			REGISTER_CMD_PARAMS("poke", poke_cmd);
-			REGISTER_CMD_PARAMS("pokeAbsolute", pokeAbsolute_cmd);
-			REGISTER_CMD_PARAMS("pokeMain", pokeMain_cmd);
-
-			REGISTER_CMD("pointerAll", pointerAll_cmd);
-			REGISTER_CMD("pointerRelative", pointerRelative_cmd);
-			REGISTER_CMD("pointerPeek", pointerPeek_cmd);
-			REGISTER_CMD("pointerPeekMulti", pointerPeekMulti_cmd);
-			REGISTER_CMD_PARAMS("pointerPoke", pointerPoke_cmd);
+	using Util::Args;
+	using CommandLanes::Lane;
+	using PriorityQueue::Priority;
 
-			REGISTER_CMD_PARAMS("click", click_cmd);
-			REGISTER_CMD_PARAMS("press", press_cmd);
-			REGISTER_CMD_PARAMS("release", release_cmd);
-			REGISTER_CMD_PARAMS("setStick", setStick_cmd);
-			REGISTER_CMD_PARAMS("touch", touch_cmd);
-			REGISTER_CMD_PARAMS("touchHold", touchHold_cmd);
-			REGISTER_CMD_PARAMS("touchDraw", touchDraw_cmd);
-			REGISTER_CMD_PARAMS("key", key_cmd);
-			REGISTER_CMD_PARAMS("keyMod", keyMod_cmd);
-			REGISTER_CMD_PARAMS("keyMulti", keyMulti_cmd);
-			REGISTER_CMD_NOARGS("detachController", detachController_cmd);
+	// Counters the connection's sender thread keeps, for "stats sends".
+	struct SendStats {
+		std::atomic<u64> responses { 0 };
+		std::atomic<u64> sends { 0 }; // send() calls, including retries after a full socket buffer.
+		std::atomic<u64> coalesced { 0 }; // Writes that carried more than one response.
+		std::atomic<u64> bytes { 0 };
+	};
 
-			REGISTER_CMD_BUFFER("getBuildID", getBuildID_cmd);
-			REGISTER_CMD_BUFFER("getTitleVersion", getTitleVersion_cmd);
-			REGISTER_CMD_BUFFER("getSystemLanguage", getSystemLanguage_cmd);
-			REGISTER_CMD("isProgramRunning", isProgramRunning_cmd);
-			REGISTER_CMD_BUFFER("getMainNsoBase", getMainNsoBase_cmd);
-			REGISTER_CMD_BUFFER("getHeapBase", getHeapBase_cmd);
-			REGISTER_CMD_BUFFER("charge", charge_cmd);
-			REGISTER_CMD_BUFFER("getVersion", getVersion_cmd);
-			REGISTER_CMD_BUFFER("getTitleID", getTitleID_cmd);
-			REGISTER_CMD("game", game_cmd);
-			REGISTER_CMD_PARAMS("configure", configure_cmd);
-			REGISTER_CMD_NOARGS("screenOn", screenOn_cmd);
-			REGISTER_CMD_NOARGS("screenOff", screenOff_cmd);
-			REGISTER_CMD_BUFFER("pixelPeek", pixelPeek_cmd);
-			REGISTER_CMD("ping", ping_cmd);
+	class Handler : public ControllerCommands::Controller, protected ScanCommands::Scanner, public WatchCommands::Watcher {
+	public:
+		using CmdFunc = void (*)(Handler&, Args, std::vector<char>&);
+		using StatsFunc = void (*)(Handler&, std::vector<char>&);
+		using FrameFunc = bool (*)(Handler&, const Protocol::FrameHeader&, Protocol::ArgReader&, std::vector<char>&);
 
-			REGISTER_CMD_BUFFER("getSwitchTime", getSwitchTime_cmd);
-			REGISTER_CMD("setSwitchTime", setSwitchTime_cmd);
-			REGISTER_CMD_BUFFER("resetSwitchTime", resetSwitchTime_cmd);
-#pragma endregion Command registration.
-		};
+		Handler() : Controller() {}
 
 		~Handler() override {
-            m_cmd.clear();
+            endClientSession();
             cqNotifyAll();
 			cqJoinThread();
+			watchJoinThread();
         };
 
 	public:
-		std::vector<char> HandleCommand(const std::string& cmd, const std::vector<std::string>& params);
+		std::vector<char> HandleCommand(std::string_view cmd, Args params, bool allowStream = true);
+		std::vector<char> HandleFrame(const std::string& frame, bool allowStream = true);
+		bool isBinaryProtocol();
+		static Lane getLane(std::string_view cmd);
+		static Lane getFrameLane(const std::string& frame);
+		static Priority getPriority(std::string_view cmd);
+		static Priority getFramePriority(const std::string& frame);
+		static Priority getReceivePriority(std::string_view line);
+		static Priority getReceiveFramePriority(const std::string& frame);
+		void setCommandQueue(const PriorityQueue::CommandQueue* queue);
+		void setEventClient(std::shared_ptr<ModuleBase::ClientSettings> settings);
+		void setSendStats(const SendStats* stats);
 		bool getIsEnabledPA();
 		bool getIsRunningPA();
+		void endClientDebugSession();
+		void endClientSession();
+		void closeClientSession();
+		void compressResponse(std::vector<char>& buffer);
+		void setResponseStream(ResponseStream stream);
 
 	private:
 #pragma region Vision
-		void peek_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
-		void peekMulti_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
-		void peekAbsolute_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
-		void peekAbsoluteMulti_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
-		void peekMain_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
-		void peekMainMulti_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
+		void peek_cmd(Args params, std::vector<char>& buffer);
+		void peekMulti_cmd(Args params, std::vector<char>& buffer);
+		void peekAbsolute_cmd(Args params, std::vector<char>& buffer);
+		void peekAbsoluteMulti_cmd(Args params, std::vector<char>& buffer);
+		void peekMain_cmd(Args params, std::vector<char>& buffer);
+		void peekMainMulti_cmd(Args params, std::vector<char>& buffer);
+		void peekDelta_cmd(Args params, std::vector<char>& buffer);
+		void peekDeltaAbsolute_cmd(Args params, std::vector<char>& buffer);
+		void peekDeltaMain_cmd(Args params, std::vector<char>& buffer);
+		void peekDeltaClear_cmd();
 
-		void poke_cmd(const std::vector<std::string>& params);
-		void pokeAbsolute_cmd(const std::vector<std::string>& params);
-		void pokeMain_cmd(const std::vector<std::string>& params);
+		void poke_cmd(Args params);
+		void pokeAbsolute_cmd(Args params);
+		void pokeMain_cmd(Args params);
 
-		void pointerAll_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
-		void pointerRelative_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
-		void pointerPeek_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
-		void pointerPeekMulti_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
-		void pointerPoke_cmd(const std::vector<std::string>& params);
+		void pointerAll_cmd(Args params, std::vector<char>& buffer);
+		void pointerRelative_cmd(Args params, std::vector<char>& buffer);
+		void pointerPeek_cmd(Args params, std::vector<char>& buffer);
+		void pointerPeekMulti_cmd(Args params, std::vector<char>& buffer);
+		void pointerPoke_cmd(Args params);
+		void regionMap_cmd(std::vector<char>& buffer);
 #pragma endregion Various memory read/write commands.
+#pragma region Scan
+		void scanStart_cmd(Args params, std::vector<char>& buffer);
+		void scanNext_cmd(Args params, std::vector<char>& buffer);
+		void scanResults_cmd(Args params, std::vector<char>& buffer);
+		void scanReset_cmd();
+#pragma endregion Incremental value scan commands.
+#pragma region Watch
+		void watchAdd_cmd(Args params);
+		void watchRemove_cmd(Args params);
+#pragma endregion Memory watch subscription commands.
 #pragma region Controller
-		void click_cmd(const std::vector<std::string>& params);
-		void press_cmd(const std::vector<std::string>& params);
-		void release_cmd(const std::vector<std::string>& params);
-		void setStick_cmd(const std::vector<std::string>& params);
-		void touch_cmd(const std::vector<std::string>& params);
-		void touchHold_cmd(const std::vector<std::string>& params);
-		void touchDraw_cmd(const std::vector<std::string>& params);
-		void key_cmd(const std::vector<std::string>& params);
-		void keyMod_cmd(const std::vector<std::string>& params);
-		void keyMulti_cmd(const std::vector<std::string>& params);
+		void click_cmd(Args params);
+		void press_cmd(Args params);
+		void release_cmd(Args params);
+		void setStick_cmd(Args params);
+		void touch_cmd(Args params);
+		void touchHold_cmd(Args params);
+		void touchDraw_cmd(Args params);
+		void key_cmd(Args params);
+		void keyMod_cmd(Args params);
+		void keyMulti_cmd(Args params);
 #pragma endregion Various controller commands.
 #pragma region Base
 		void getBuildID_cmd(std::vector<char>& buffer);
 		void getTitleVersion_cmd(std::vector<char>& buffer);
 		void getSystemLanguage_cmd(std::vector<char>& buffer);
-		void isProgramRunning_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
+		void isProgramRunning_cmd(Args params, std::vector<char>& buffer);
 		void getMainNsoBase_cmd(std::vector<char>& buffer);
 		void getHeapBase_cmd(std::vector<char>& buffer);
 		void charge_cmd(std::vector<char>& buffer);
 		void getTitleID_cmd(std::vector<char>& buffer);
-		void game_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
+		void game_cmd(Args params, std::vector<char>& buffer);
 		void screenOn_cmd();
 		void screenOff_cmd();
 		void detachController_cmd();
@@ -134,14 +142,72 @@ namespace CommandHandler {
 #pragma endregion Various base libnx commands.
 #pragma region Misc
 		void getVersion_cmd(std::vector<char>& buffer);
-		void configure_cmd(const std::vector<std::string>& params);
-		void ping_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
+		void configure_cmd(Args params);
+		void ping_cmd(Args params, std::vector<char>& buffer);
+		void barrier_cmd(std::vector<char>& buffer);
+		void reloadConfig_cmd(std::vector<char>& buffer);
 #pragma endregion Miscellaneous commands that get/set parameters.
 #pragma region Time
 		void getSwitchTime_cmd(std::vector<char>& buffer);
-		void setSwitchTime_cmd(const std::vector<std::string>& params, std::vector<char>& buffer);
+		void setSwitchTime_cmd(Args params, std::vector<char>& buffer);
 		void resetSwitchTime_cmd(std::vector<char>& buffer);
 #pragma endregion Time commands.
-		std::unordered_map<std::string, CmdFunc> m_cmd;
+#pragma region Session
+		void debugSessionBegin_cmd();
+		void debugSessionEnd_cmd();
+#pragma endregion Client-defined debug session commands.
+#pragma region Batch
+		static constexpr size_t ExecMaxCommands = 32;
+
+		void exec_cmd(Args params, std::vector<char>& buffer);
+		static bool isBatchable(std::string_view cmd);
+#pragma endregion Multi-command batches.
+#if defined(SBB_BENCHMARKS)
+#pragma region Benchmark
+		void benchmark_cmd(Args params, std::vector<char>& buffer);
+		void benchmarkAttach(Args params, std::vector<char>& buffer);
+		void benchmarkPeekMulti(Args params, std::vector<char>& buffer);
+		void benchmarkCompress(Args params, std::vector<char>& buffer);
+		void benchmarkParse(Args params, std::vector<char>& buffer);
+		void benchmarkDispatch(Args params, std::vector<char>& buffer);
+		void benchmarkHex(Args params, std::vector<char>& buffer);
+		void benchmarkPool(Args params, std::vector<char>& buffer);
+		void benchmarkClients(Args params, std::vector<char>& buffer);
+		void benchmarkLatency(Args params, std::vector<char>& buffer);
+		void benchmarkUsbRing(Args params, std::vector<char>& buffer);
+#pragma endregion On-device benchmarks.
+#endif
+#pragma region Stats
+		void stats_cmd(Args params, std::vector<char>& buffer);
+		void statsMetaCache(std::vector<char>& buffer);
+		void statsPointerCache(std::vector<char>& buffer);
+		void statsBufferPool(std::vector<char>& buffer);
+		void statsQueues(std::vector<char>& buffer);
+		void statsSends(std::vector<char>& buffer);
+#pragma endregion Runtime counters.
+#pragma region Protocol
+		void protocol_cmd(Args params, std::vector<char>& buffer);
+		void updateApplicationMetaData();
+		bool resolveFrameAddress(u32 base, u64 offset, u64& address);
+		bool frameCommand(const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload);
+		bool framePeek(const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload);
+		bool framePeekMulti(const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload);
+		bool framePoke(const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload);
+		bool framePointerPeek(const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload);
+#pragma endregion Binary protocol v2.
+		static const CmdFunc* findCommand(std::string_view name);
+#if defined(SBB_BENCHMARKS)
+		static const CmdFunc* findBenchmark(std::string_view name);
+#endif
+		static const StatsFunc* findStats(std::string_view name);
+		static const FrameFunc* findFrame(u16 opcode);
+		bool m_frameStreamed = false; // Set when a frame handler already sent its response through the response stream.
+		const PriorityQueue::CommandQueue* m_commandQueue = nullptr; // The connection's receive queue, for stats only.
+		const SendStats* m_sendStats = nullptr; // The connection's sender counters, for stats only.
+
+		// Input and capture commands neither hold the debug handle nor touch application metadata, so their lanes run beside the memory lane.
+		static bool needsDebugSession(Lane lane) {
+			return lane != Lane::Input && lane != Lane::Capture;
+		}
 	};
 }
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "defines.h"
+#include "lockFreeQueue.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <switch.h>
+
+namespace CommandLanes {
+	/**
+	 * @brief Execution lanes for tagged commands. Each lane has its own worker, so a blocking click or a screenshot doesn't hold up memory reads.
+	 * Barrier commands run on the command thread once every lane has drained.
+	 */
+	enum class Lane : u8 {
+		Memory,
+		Input,
+		Capture,
+		System,
+		Barrier,
+	};
+
+	static constexpr size_t LaneCount = 4; // Lanes with a worker; Barrier runs on the command thread.
+
+	struct Request {
+		std::string requestId;
+		std::string command; // The command line, or the whole frame for the binary protocol.
+		bool frame;
+		u32 client = 0; // The id of the client that sent it, 0 for a single-client connection.
+	};
+
+	class Lanes {
+	public:
+		using RequestFunc = std::function<void(Request&, std::vector<std::string_view>&)>;
+
+		Lanes(std::atomic_bool& stop, std::atomic_bool& error) : m_stop(stop), m_error(error) {}
+		~Lanes() {}
+
+		Lanes(const Lanes&) = delete;
+		Lanes& operator=(const Lanes&) = delete;
+
+		void start(RequestFunc handler);
+		void join();
+		bool push(Lane lane, Request&& request);
+		void barrier();
+		void clear();
+		void notifyAll();
+
+		static std::string_view laneName(Lane lane);
+
+	private:
+		static constexpr size_t LaneDepth = 64;
+
+		struct Worker {
+			std::thread thread;
+			LocklessQueue::LockFreeQueue<Request, LaneDepth> queue;
+			std::mutex mutex;
+			std::condition_variable cv;
+			std::atomic<u32> pending { 0 }; // Queued plus running requests.
+		};
+
+		void run(Worker& worker, Lane lane, const RequestFunc& handler);
+		void finish(Worker& worker, u32 count);
+		void drain(Worker& worker);
+		bool idle() const;
+
+		std::array<Worker, LaneCount> m_workers;
+		std::mutex m_idleMutex;
+		std::condition_variable m_idleCv;
+		std::atomic_bool& m_stop;
+		std::atomic_bool& m_error;
+	};
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "defines.h"
+#include <vector>
+#include <switch.h>
+
+namespace Compression {
+	/**
+	 * @brief Minimal LZ4 block format codec. Raw blocks only, no frame header or checksum, so any LZ4 block decoder can read the output.
+	 */
+	class Lz4 {
+	public:
+		Lz4() {}
+		~Lz4() {}
+
+	public:
+		static size_t compressBound(size_t size);
+		static void compress(const char* data, size_t size, std::vector<char>& out);
+		static bool decompress(const char* data, size_t size, char* out, size_t outSize);
+
+	private:
+		static constexpr size_t MinMatch = 4;
+		static constexpr size_t LastLiterals = 5;
+		static constexpr size_t MatchFindLimit = 12;
+		static constexpr size_t MaxDistance = 0xFFFF;
+		static constexpr u32 HashLog = 12;
+		static constexpr u32 SkipTrigger = 6;
+
+		static u8* writeSequence(u8* op, const u8* literals, size_t literalLength, size_t offset, size_t matchLength);
+		static u8* writeLength(u8* op, size_t length);
+	};
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "defines.h"
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <switch.h>
+
+namespace Config {
+	enum class Transport : u8 {
+		Wifi,
+		Usb,
+	};
+
+	// One parse of config.cfg. Never modified once published, so readers need no lock.
+	struct Snapshot {
+		Transport transport = Transport::Wifi;
+		u16 udpPort = 0; // UDP side channel for controller queue commands over WiFi; 0 leaves it off.
+	};
+
+	class Settings {
+	public:
+		static Settings& instance() {
+			static Settings settingsInstance;
+			return settingsInstance;
+		}
+
+		void load();
+		std::shared_ptr<const Snapshot> reload();
+
+		std::shared_ptr<const Snapshot> snapshot() const {
+			return m_snapshot.load(std::memory_order_acquire);
+		}
+
+		/**
+		 * @brief The transport the running connection was set up with. Fixed by load(); reload() does not change it.
+		 */
+		Transport transport() const {
+			return m_transport.load(std::memory_order_relaxed);
+		}
+
+		static std::string_view transportName(Transport transport) {
+			return transport == Transport::Usb ? "usb" : "wifi";
+		}
+
+	private:
+		Settings() : m_snapshot(std::make_shared<const Snapshot>()), m_transport(Transport::Wifi) {}
+		~Settings() {}
+
+		Settings(const Settings&) = delete;
+		Settings& operator=(const Settings&) = delete;
+
+		static std::shared_ptr<const Snapshot> parse();
+
+		std::atomic<std::shared_ptr<const Snapshot>> m_snapshot;
+		std::atomic<Transport> m_transport;
+	};
+}
@@ -5,13 +5,14 @@
 #include "lockFreeQueue.h"
 #include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <malloc.h>
 #include <mutex>
 #include <switch.h>
-#include <unordered_map>
 
 namespace ControllerCommands {
     using namespace LocklessQueue;
+    using Util::Args;
 
 	class Controller : protected virtual ModuleBase::BaseCommands {
 	public:
@@ -43,6 +44,7 @@ namespace ControllerCommands {
 
 	public:
 		using WallClock = std::chrono::steady_clock::time_point;
+		using FinishedSink = std::function<bool(u64 seqnum)>; // Returns true if it reported the finished command itself.
 
 		struct ControllerState {
 			uint64_t buttons = 0;
@@ -78,25 +80,13 @@ namespace ControllerCommands {
 			}
 
 			void parseFromHex(const char str[64]) {
-				char* ptr = (char*)this;
-				for (size_t c = 0; c < 64; c += 2) {
-					char hi = str[c + 0];
-					char lo = str[c + 1];
-					hi = (hi >= '0' && hi <= '9') ? hi - '0' :
-						 (hi >= 'a' && hi <= 'f') ? hi - 'a' + 10 :
-						 (hi >= 'A' && hi <= 'F') ? hi - 'A' + 10 : 0;
-					lo = (lo >= '0' && lo <= '9') ? lo - '0' :
-						 (lo >= 'a' && lo <= 'f') ? lo - 'a' + 10 :
-						 (lo >= 'A' && lo <= 'F') ? lo - 'A' + 10 : 0;
-					ptr[0] = hi << 4 | lo;
-					ptr++;
-				}
+				Util::Utils::hexDecode(str, 32, reinterpret_cast<char*>(this));
 			}
 		};
 
 	public:
-		static int parseStringToButton(const std::string& arg);
-		static int parseStringToStick(const std::string& arg);
+		static int parseStringToButton(std::string_view arg);
+		static int parseStringToStick(std::string_view arg);
 
         void startControllerThread(LockFreeQueue<std::vector<char>>& senderQueue, std::condition_variable& senderCv, std::atomic_bool& stop, std::atomic_bool& error);
 		void cqEnqueueCommand(const ControllerCommand& cmd);
@@ -104,6 +94,7 @@ namespace ControllerCommands {
 		void cqCancel();
 		void cqNotifyAll();
         void cqJoinThread();
+		void cqSetFinishedSink(FinishedSink sink);
 
 	protected:
 		std::atomic_bool m_ccThreadRunning { false };
@@ -117,7 +108,7 @@ namespace ControllerCommands {
 		void setStickState(const Joystick& stick, int dxVal, int dyVal);
 		void touch(std::vector<HidTouchState>& state, u64 sequentialCount, u64 holdTime, bool hold);
 		void key(const std::vector<HiddbgKeyboardAutoPilotState>& states, u64 sequentialCount);
-		void setControllerType(const std::vector<std::string>& params);
+		void setControllerType(Args params);
 
 	private:
 		void commandLoopPA(LockFreeQueue<std::vector<char>>& senderQueue, std::condition_variable& senderCv, std::atomic_bool& stop, std::atomic_bool& error);
@@ -172,14 +163,12 @@ namespace ControllerCommands {
 			u8 state;
 		};
 
-		static std::unordered_map<std::string, int> m_button;
-		static std::unordered_map<std::string, int> m_stick;
-
 		bool m_replaceOnNext = false;
 
 		std::thread m_ccThread;
 		LockFreeQueue<ControllerCommand> m_ccQueue;
 		ControllerCommand m_ccCurrentCommand;
+		FinishedSink m_ccFinishedSink; // Set before the controller thread starts.
 		std::mutex m_ccMutex;
 		std::condition_variable m_ccCv;
 
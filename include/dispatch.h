@@ -0,0 +1,60 @@
+#pragma once
+
+#include "defines.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+namespace Dispatch {
+	void duplicateKey(); // Not constexpr, so a table with a duplicate key fails to compile.
+
+	template <typename Key, typename Value>
+	struct Entry {
+		Key key;
+		Value value;
+	};
+
+	/**
+	 * @brief A fixed lookup table sorted at compile time. Lookup is a binary search with no hashing or allocation.
+	 */
+	template <typename Key, typename Value, size_t N>
+	class Table {
+	public:
+		consteval Table(const Entry<Key, Value> (&entries)[N]) {
+			std::copy(entries, entries + N, m_entries.begin());
+			std::sort(m_entries.begin(), m_entries.end(), [](const auto& a, const auto& b) { return a.key < b.key; });
+			for (size_t i = 1; i < N; ++i) {
+				if (!(m_entries[i - 1].key < m_entries[i].key)) {
+					duplicateKey();
+				}
+			}
+		}
+
+		/**
+		 * @brief Find the value registered for a key.
+		 * @param The key.
+		 * @return The value, or nullptr if the key is not registered.
+		 */
+		constexpr const Value* find(const Key& key) const {
+			auto it = std::lower_bound(m_entries.begin(), m_entries.end(), key, [](const auto& entry, const Key& k) { return entry.key < k; });
+			return it != m_entries.end() && it->key == key ? &it->value : nullptr;
+		}
+
+		constexpr auto begin() const { return m_entries.begin(); }
+		constexpr auto end() const { return m_entries.end(); }
+		constexpr size_t size() const { return N; }
+
+	private:
+		std::array<Entry<Key, Value>, N> m_entries {};
+	};
+
+	/**
+	 * @brief Build a table at compile time. The entry count is deduced from the braced list.
+	 * @param The entries, in any order.
+	 * @return The sorted table.
+	 */
+	template <typename Key, typename Value, size_t N>
+	consteval Table<Key, Value, N> makeTable(const Entry<Key, Value> (&entries)[N]) {
+		return Table<Key, Value, N>(entries);
+	}
+}
@@ -2,6 +2,9 @@
 
 #include "defines.h"
 #include "moduleBase.h"
+#include <atomic>
+#include <functional>
+#include <map>
 #include <vector>
 #include <switch.h>
 
@@ -13,14 +16,118 @@ namespace MemoryCommands {
 		Vision() : BaseCommands() {}
 		~Vision() override {}
 
+	public:
+		// Pushes one chunk of a response to the sender thread, blocking while too many chunks are queued. Returns false if the connection failed.
+		using ResponseStream = std::function<bool(std::vector<char>&&)>;
+
 	protected:
+		static constexpr u64 PageSize = 0x1000;
+
+		struct ReadSpan {
+			u64 offset;
+			u64 size;
+			size_t first; // Index into ReadPlan::order of the first range served by this read.
+			size_t count;
+		};
+
+		struct ReadPlan {
+			std::vector<size_t> order; // Non-empty request indices sorted by offset.
+			std::vector<ReadSpan> spans;
+		};
+
+		struct MemoryRegion {
+			u64 addr;
+			u64 size;
+			u32 type;
+			u32 perm;
+		};
+
+		struct PointerCacheEntry {
+			u64 lastHop; // Resolved address of the final pointer read in the chain.
+			u64 expiresTick;
+		};
+
+		u64 m_kernelReadCount = 0;
+		u64 m_pointerCacheHits = 0;
+		u64 m_pointerCacheMisses = 0;
+		ResponseStream m_responseStream;
+		std::atomic_bool m_responseStreaming { false };
+		bool m_limitWholeReads = false; // Whole reads above Protocol::MaxFrameLength are refused while set.
+
+		/**
+		 * @brief Hold back the response stream for one command, so large reads come back whole, and restore it however the command ends.
+		 */
+		class WholeReads {
+		public:
+			WholeReads(Vision& vision, bool limit) : m_vision(vision), m_stream(std::move(vision.m_responseStream)), m_limit(vision.m_limitWholeReads) {
+				vision.m_responseStream = nullptr;
+				vision.m_limitWholeReads = limit;
+			}
+
+			~WholeReads() {
+				m_vision.m_responseStream = std::move(m_stream);
+				m_vision.m_limitWholeReads = m_limit;
+			}
+
+			WholeReads(const WholeReads&) = delete;
+			WholeReads& operator=(const WholeReads&) = delete;
+
+		private:
+			Vision& m_vision;
+			ResponseStream m_stream;
+			bool m_limit;
+		};
+
 		void peek(u64 offset, u64 size, std::vector<char>& buffer);
+		void peekStreamed(u64 offset, u64 size, std::vector<char>& buffer, std::vector<char> header = {});
+		Result readRange(u64 offset, u64 size, std::vector<char>& buffer);
+		void peekDelta(u64 offset, u64 size, u32 lastSeq, std::vector<char>& buffer);
+		void clearDeltaSnapshots();
 		void peekMulti(const std::vector<u64>& offsets, const std::vector<u64>& sizes, std::vector<char>& buffer);
+		ReadPlan planReads(const std::vector<u64>& offsets, const std::vector<u64>& sizes) const;
+		Result readMulti(const std::vector<u64>& offsets, const std::vector<u64>& sizes, std::vector<char>& buffer);
 
 		void poke(u64 offset, u64 size, const std::vector<char>& buffer);
 
 		u64 followMainPointer(const s64& main, const std::vector<s64>& jumps, std::vector<char>& buffer);
+		void flushPointerCache();
+		const std::vector<MemoryRegion>& getRegionMap(bool refresh = false);
+		bool checkRange(u64 offset, u64 size, bool requireRead);
+		u64 getRegionEnd(u64 offset) const;
 		Result readMem(const std::vector<char>& data, u64 offset, u64 size, u64 multi = 0);
 		void writeMem(u64 offset, u64 size, const std::vector<char>& buffer);
+
+	private:
+		static constexpr size_t PointerCacheCapacity = 64;
+		static constexpr u64 RegionMapRefreshMs = 1000;
+		static constexpr size_t DeltaSnapshotCapacity = 32;
+		static constexpr u64 DeltaSnapshotMaxSize = 0x10000;
+		static constexpr u64 DeltaSpanMergeGap = 8;
+
+		struct DeltaSnapshot {
+			std::vector<char> data;
+			u32 seq;
+		};
+
+		u64 walkMainPointer(const s64& main, const std::vector<s64>& jumps, std::vector<char>& buffer, u64& lastHop);
+
+		std::map<std::vector<s64>, PointerCacheEntry> m_pointerCache; // Keyed by [main, jump1, jump2, ...].
+		u64 m_pointerCachePid = 0;
+		u64 m_pointerCacheHeapBase = 0;
+
+		const MemoryRegion* findRegion(u64 offset) const;
+		bool rangeInRegions(u64 offset, u64 size, bool requireRead) const;
+
+		std::vector<MemoryRegion> m_regions; // Mapped regions of the application, sorted by address.
+		bool m_regionMapValid = false;
+		u64 m_regionMapPid = 0;
+		u64 m_regionMapTick = 0;
+
+		struct DeltaSnapshots {
+			std::map<std::pair<u64, u64>, DeltaSnapshot> regions; // Keyed by (address, size).
+			u64 pid = 0;
+		};
+
+		std::map<const ModuleBase::ClientSettings*, DeltaSnapshots> m_deltaSnapshots; // One set per client, keyed by its settings. Guarded by the debug mutex.
 	};
 }
@@ -2,45 +2,79 @@
 
 #include "defines.h"
 #include "util.h"
+#include "protocol.h"
+#include "dispatch.h"
 #include <atomic>
-#include <unordered_map>
+#include <memory>
+#include <mutex>
 
 #define REGISTER_CFG_CMD(name, function) \
-    (m_configure)[(name)] = [this](const std::vector<std::string>& params) { this->function(params); }
+    { (name), [](BaseCommands& self, Args params) { self.function(params); } }
 
 #define REGISTER_GAME_CMD(name, function) \
-    (m_game)[(name)] = [this](std::vector<char>& buffer) { this->function(buffer); }
+    { (name), [](BaseCommands& self, std::vector<char>& buffer) { self.function(buffer); } }
 
 namespace ModuleBase {
 	using namespace Util;
 
+	// Settings each client negotiates for itself. Every socket client has its own copy; USB uses the handler's defaults.
+	struct ClientSettings {
+		std::atomic<u32> protocolVersion { Protocol::TextVersion };
+		std::atomic_bool compressionEnabled { false };
+		std::atomic<u64> compressionThreshold { 0x1000 };
+		std::atomic<u64> sendBatchBytes { 0x4000 }; // Most bytes of queued replies coalesced into one send(); 0 sends each reply on its own.
+		std::atomic<u64> sendLingerUs { 0 }; // How long a lone reply waits for others to share its send().
+		bool debugSession = false; // Set while the client holds a debugSessionBegin. Guarded by the handler's debug mutex.
+		bool closed = false; // Set once the client is gone, so a request still in flight can't start a session nobody will end. Guarded likewise.
+	};
+
+	/**
+	 * @brief Makes a client's settings the ones the handler sees on this thread for the lifetime of the scope.
+	 */
+	class ClientScope {
+	public:
+		explicit ClientScope(ClientSettings& settings) : m_previous(s_current) {
+			s_current = &settings;
+		}
+
+		~ClientScope() {
+			s_current = m_previous;
+		}
+
+		ClientScope(const ClientScope&) = delete;
+		ClientScope& operator=(const ClientScope&) = delete;
+
+		static ClientSettings* current() {
+			return s_current;
+		}
+
+	private:
+		ClientSettings* m_previous;
+		static inline thread_local ClientSettings* s_current = nullptr;
+	};
+
 	class BaseCommands {
 	public:
-		BaseCommands() {
-			REGISTER_CFG_CMD("buttonClickSleepTime", setButtonClickSleepTime);
-			REGISTER_CFG_CMD("keySleepTime", setKeySleepTime);
-			REGISTER_CFG_CMD("fingerDiameter", setFingerDiameter);
-			REGISTER_CFG_CMD("pollRate", setPollRate);
-			REGISTER_CFG_CMD("enablePA", setEnabledPA);
-			REGISTER_CFG_CMD("enableLogs", setEnabledLogs);
-            REGISTER_CFG_CMD("enableBackwardsCompat", setEnabledBackwards);
-
-			REGISTER_GAME_CMD("icon", getGameIcon);
-			REGISTER_GAME_CMD("version", getGameVersion);
-			REGISTER_GAME_CMD("rating", getGameRating);
-			REGISTER_GAME_CMD("author", getGameAuthor);
-			REGISTER_GAME_CMD("name", getGameName);
-		};
+		BaseCommands() {}
 
 		virtual ~BaseCommands() {}
 
 	protected:
 		Handle m_debugHandle = 0;
+		u64 m_debugPid = 0;
+		u32 m_debugSessionDepth = 0;
+		u32 m_clientDebugSessions = 0; // Sessions held open by clients with debugSessionBegin, which yieldDebugHandle() leaves alone.
+		std::recursive_mutex m_debugMutex; // Guards the debug handle and metadata across the command and watch threads.
 		u64 m_buttonClickSleepTime = 50;
 		u64 m_keyPressSleepTime = 25;
 		u64 m_pollRate = 17;
 		u32 m_fingerDiameter = 50;
+		u64 m_peekGapThreshold = 0x200;
+		bool m_pointerCacheEnabled = false;
+		u64 m_pointerCacheTtl = 1000;
 		std::atomic_bool m_isEnabledPA { false };
+		ClientSettings m_defaultSettings;
+		std::atomic<std::shared_ptr<ClientSettings>> m_eventSettings; // Settings of the client that receives unsolicited messages, if not the defaults.
 
 		struct MetaData {
 			u64 main_nso_base = 0;
@@ -52,13 +86,20 @@ namespace ModuleBase {
 		};
 
 		MetaData m_metaData = { 0 };
+		bool m_metaDataValid = false;
+		u64 m_metaCacheHits = 0;
+		u64 m_metaCacheMisses = 0;
+
 		enum Joystick {
 			Left = 0,
 			Right = 1,
 		};
 
-		std::unordered_map<std::string, std::function<void(const std::vector<std::string>&)>> m_configure;
-		std::unordered_map<std::string, std::function<void(std::vector<char>&)>> m_game;
+		using ConfigureFunc = void (*)(BaseCommands&, Args);
+		using GameFunc = void (*)(BaseCommands&, std::vector<char>&);
+
+		static const ConfigureFunc* findConfigure(std::string_view name);
+		static const GameFunc* findGame(std::string_view name);
 
 	protected:
 		std::string getSbbVersion() {
@@ -69,9 +110,25 @@ namespace ModuleBase {
 			return m_isEnabledPA;
 		}
 
+		/**
+		 * @brief The settings of the client whose command is running on this thread, or the defaults outside any ClientScope.
+		 */
+		ClientSettings& clientSettings() {
+			ClientSettings* settings = ClientScope::current();
+			return settings ? *settings : m_defaultSettings;
+		}
+
 		bool attach();
 		void detach();
-		void initMetaData();
+		void beginDebugSession();
+		void endDebugSession();
+		void closeDebugHandle();
+		void yieldDebugHandle();
+		bool initMetaData();
+		void updateMetaData(u64 pid);
+		void invalidateMetaData();
+		std::vector<char> makeEventMessage(const std::string& message);
+		std::vector<char> makeEventMessage(const std::string& message, const ClientSettings& client);
 
 		u64 getMainNsoBase();
 		u64 getHeapBase();
@@ -84,18 +141,46 @@ namespace ModuleBase {
 		void setScreen(const ViPowerState& state);
 
 		void getSwitchTime(std::vector<char>& buffer);
-		void setSwitchTime(const std::vector<std::string>& params, std::vector<char>& buffer);
+		void setSwitchTime(Args params, std::vector<char>& buffer);
 		void resetSwitchTime(std::vector<char>& buffer);
 
+		/**
+		 * @brief Keeps the debug handle open and locked for the lifetime of the scope. Nested scopes share one handle.
+		 */
+		class DebugSession {
+		public:
+			explicit DebugSession(BaseCommands& base) : m_base(base), m_lock(base.m_debugMutex) {
+				m_base.beginDebugSession();
+			}
+
+			~DebugSession() {
+				m_base.endDebugSession();
+			}
+
+			DebugSession(const DebugSession&) = delete;
+			DebugSession& operator=(const DebugSession&) = delete;
+
+		private:
+			BaseCommands& m_base;
+			std::lock_guard<std::recursive_mutex> m_lock;
+		};
+
 	private:
 		static std::string getCurrentSbbVersion() {
             return !g_enableBackwardsCompat ? "3.32\r\n" : "3.33\r\n";
         }
 
-        void setButtonClickSleepTime(const std::vector<std::string>& params);
-		void setKeySleepTime(const std::vector<std::string>& params);
-		void setFingerDiameter(const std::vector<std::string>& params);
-		void setPollRate(const std::vector<std::string>& params);
+        void setButtonClickSleepTime(Args params);
+		void setKeySleepTime(Args params);
+		void setFingerDiameter(Args params);
+		void setPollRate(Args params);
+		void setPeekGapThreshold(Args params);
+		void setPointerCache(Args params);
+		void setPointerCacheTtl(Args params);
+		void setCompression(Args params);
+		void setCompressionThreshold(Args params);
+		void setSendBatch(Args params);
+		void setSendLinger(Args params);
 
 		void getGameIcon(std::vector<char>& buffer);
 		void getGameVersion(std::vector<char>& buffer);
@@ -103,9 +188,9 @@ namespace ModuleBase {
 		void getGameAuthor(std::vector<char>& buffer);
 		void getGameName(std::vector<char>& buffer);
 
-		void setEnabledPA(const std::vector<std::string>& params);
-        void setEnabledLogs(const std::vector<std::string>& params);
-        void setEnabledBackwards(const std::vector<std::string>& params);
+		void setEnabledPA(Args params);
+        void setEnabledLogs(Args params);
+        void setEnabledBackwards(Args params);
 
 		bool isConnectedToInternet();
 		bool metaHasZeroValue(const MetaData& meta);
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "defines.h"
+#include "lockFreeQueue.h"
+#include <atomic>
+#include <string>
+#include <switch.h>
+
+namespace PriorityQueue {
+	enum class Priority : u8 {
+		Urgent,
+		Bulk,
+	};
+
+	/**
+	 * @brief The receive path's command queue, split so urgent commands have their own slots and are always popped first.
+	 * A flood of bulk peeks can fill the bulk queue but never delay or drop an urgent command.
+	 */
+	class CommandQueue {
+	public:
+		struct Stats {
+			u64 depth;
+			u64 peakDepth;
+			u64 pushed;
+			u64 drops;
+		};
+
+		CommandQueue() {}
+		~CommandQueue() {}
+
+		CommandQueue(const CommandQueue&) = delete;
+		CommandQueue& operator=(const CommandQueue&) = delete;
+
+		/**
+		 * @brief Queue a received command or frame.
+		 * @param The priority.
+		 * @param The command line or frame.
+		 * @param The id of the client that sent it, 0 for a single-client connection.
+		 * @return false if that priority's queue was full and the command was dropped.
+		 */
+		bool push(Priority priority, std::string&& command, u32 client = 0) {
+			Counters& counters = m_counters[(size_t)priority];
+			Entry entry { std::move(command), client };
+			bool pushed = priority == Priority::Urgent ? m_urgent.push(std::move(entry)) : m_bulk.push(std::move(entry));
+			if (!pushed) {
+				counters.drops.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			counters.pushed.fetch_add(1, std::memory_order_relaxed);
+			u64 depth = priority == Priority::Urgent ? m_urgent.size() : m_bulk.size();
+			u64 peak = counters.peakDepth.load(std::memory_order_relaxed);
+			while (depth > peak && !counters.peakDepth.compare_exchange_weak(peak, depth, std::memory_order_relaxed)) {}
+			return true;
+		}
+
+		/**
+		 * @brief Take the next command, urgent ones first.
+		 * @param[out] The command.
+		 * @param[out] Its priority.
+		 * @param[out] The id of the client that sent it.
+		 * @return false if both queues are empty.
+		 */
+		bool pop(std::string& command, Priority& priority, u32& client) {
+			Entry entry;
+			if (m_urgent.pop(entry)) {
+				priority = Priority::Urgent;
+			} else if (m_bulk.pop(entry)) {
+				priority = Priority::Bulk;
+			} else {
+				return false;
+			}
+
+			command = std::move(entry.command);
+			client = entry.client;
+			return true;
+		}
+
+		bool empty() const {
+			return m_urgent.empty() && m_bulk.empty();
+		}
+
+		void clear() {
+			m_urgent.clear();
+			m_bulk.clear();
+		}
+
+		Stats getStats(Priority priority) const {
+			const Counters& counters = m_counters[(size_t)priority];
+			return Stats {
+				priority == Priority::Urgent ? m_urgent.size() : m_bulk.size(),
+				counters.peakDepth.load(std::memory_order_relaxed),
+				counters.pushed.load(std::memory_order_relaxed),
+				counters.drops.load(std::memory_order_relaxed),
+			};
+		}
+
+	private:
+		struct Entry {
+			std::string command;
+			u32 client = 0;
+		};
+
+		struct Counters {
+			std::atomic<u64> peakDepth { 0 };
+			std::atomic<u64> pushed { 0 };
+			std::atomic<u64> drops { 0 };
+		};
+
+		LocklessQueue::LockFreeQueue<Entry, 64> m_urgent;
+		LocklessQueue::LockFreeQueue<Entry> m_bulk;
+		Counters m_counters[2];
+	};
+}
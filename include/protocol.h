@@ -0,0 +1,87 @@
+#pragma once
+
+#include "defines.h"
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <switch.h>
+
+namespace Protocol {
+	/**
+	 * @brief Binary protocol v2. Every message is a little-endian FrameHeader followed by length bytes of arguments and payload.
+	 * Responses echo the request's opcode and request id. Selected per connection with the "protocol 2" text command.
+	 */
+	static constexpr u32 TextVersion = 1;
+	static constexpr u32 BinaryVersion = 2;
+	static constexpr u32 MaxFrameLength = 0x100000;
+
+	struct FrameHeader {
+		u32 length; // Bytes following the header.
+		u16 opcode;
+		u16 flags;
+		u32 requestId;
+	};
+
+	static_assert(sizeof(FrameHeader) == 12, "FrameHeader must be packed to 12 bytes.");
+
+	enum Opcode : u16 {
+		Command = 0x00, // Payload: a text command line. Response: the text command's response bytes.
+		Peek = 0x01, // Args: u32 base, u32 size, u64 offset. Response: raw bytes.
+		PeekMulti = 0x02, // Args: u32 base, u32 count, then count * (u64 offset, u64 size). Response: raw bytes in request order.
+		Poke = 0x03, // Args: u32 base, u32 size, u64 offset, then size bytes. Response: empty.
+		PointerPeek = 0x04, // Args: u32 size, u32 jump count, s64 final jump, s64 main jump, then count * s64 jump. Response: raw bytes.
+		SetProtocol = 0x0F, // Args: u32 version. Response: empty, sent in the old protocol's framing.
+		Event = 0x8000, // Console to client only. Payload: an unsolicited text message such as watchChanged.
+	};
+
+	enum Base : u32 {
+		Heap = 0,
+		Main = 1,
+		Absolute = 2,
+	};
+
+	enum Flags : u16 {
+		None = 0,
+		Error = 1 << 0,
+	};
+
+	class Frame {
+	public:
+		Frame() {}
+		~Frame() {}
+
+	public:
+		static std::vector<char> make(u16 opcode, u16 flags, u32 requestId, const char* payload, size_t size);
+		static void writeHeader(std::vector<char>& buffer, u16 opcode, u16 flags, u32 requestId, u32 length);
+		static int extract(std::string& buffer, std::string& frame);
+		static int measure(std::string_view buffer, size_t& size);
+	};
+
+	/**
+	 * @brief Sequential little-endian reader over a frame's arguments.
+	 */
+	class ArgReader {
+	public:
+		ArgReader(const char* data, size_t size) : m_data(data), m_size(size), m_pos(0) {}
+
+		template<typename T>
+		bool read(T& value) {
+			if (m_size - m_pos < sizeof(T)) {
+				return false;
+			}
+
+			std::memcpy(&value, m_data + m_pos, sizeof(T));
+			m_pos += sizeof(T);
+			return true;
+		}
+
+		const char* current() const { return m_data + m_pos; }
+		size_t remaining() const { return m_size - m_pos; }
+
+	private:
+		const char* m_data;
+		size_t m_size;
+		size_t m_pos;
+	};
+}
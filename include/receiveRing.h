@@ -0,0 +1,105 @@
+#pragma once
+
+#include "defines.h"
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <switch.h>
+
+namespace ReceiveRing {
+	/**
+	 * @brief Fixed receive buffer, allocated once. Reads land directly in its free space and complete commands are parsed in place,
+	 * so receiving doesn't touch the heap. Consumed bytes are reclaimed by sliding the unread tail back to the start, which only ever moves a partial command.
+	 */
+	class Ring {
+	public:
+		explicit Ring(size_t capacity) : m_buffer(std::make_unique<char[]>(capacity)), m_capacity(capacity) {}
+
+		Ring(const Ring&) = delete;
+		Ring& operator=(const Ring&) = delete;
+
+		/**
+		 * @brief Free space for the next read, reclaiming consumed bytes first. Whole commands are consumed as they arrive, so at most a partial one is moved.
+		 * @param[out] How many bytes may be written.
+		 * @return Where to write them. Call commit() with the number actually written.
+		 */
+		char* writeSpace(size_t& available) {
+			if (m_head > 0) {
+				std::memmove(m_buffer.get(), m_buffer.get() + m_head, m_tail - m_head);
+				m_tail -= m_head;
+				m_head = 0;
+			}
+
+			available = m_capacity - m_tail;
+			return m_buffer.get() + m_tail;
+		}
+
+		void commit(size_t size) {
+			m_tail += size;
+		}
+
+		/**
+		 * @brief Copy bytes in, for the few the connection adds itself.
+		 * @return false if they don't fit.
+		 */
+		bool write(const char* data, size_t size) {
+			size_t available = 0;
+			char* dst = writeSpace(available);
+			if (size > available) {
+				return false;
+			}
+
+			std::memcpy(dst, data, size);
+			commit(size);
+			return true;
+		}
+
+		/**
+		 * @brief The bytes received and not yet consumed. Valid until the next writeSpace(), write() or clear().
+		 */
+		std::string_view readable() const {
+			return std::string_view(m_buffer.get() + m_head, m_tail - m_head);
+		}
+
+		void consume(size_t size) {
+			m_head += size;
+			if (m_head == m_tail) {
+				m_head = 0;
+				m_tail = 0;
+			}
+		}
+
+		void clear() {
+			m_head = 0;
+			m_tail = 0;
+		}
+
+		size_t capacity() const {
+			return m_capacity;
+		}
+
+		/**
+		 * @brief Find the next "\r\n"-terminated line.
+		 * @param The received bytes.
+		 * @param[in,out] Where to start looking; moved past the line if one is found.
+		 * @param[out] The line, terminator included, as a view into the received bytes.
+		 * @return false if no complete line is left.
+		 */
+		static bool takeLine(std::string_view data, size_t& offset, std::string_view& line) {
+			size_t pos = data.find("\r\n", offset);
+			if (pos == std::string_view::npos) {
+				return false;
+			}
+
+			line = data.substr(offset, pos + 2 - offset);
+			offset = pos + 2;
+			return true;
+		}
+
+	private:
+		std::unique_ptr<char[]> m_buffer;
+		size_t m_capacity;
+		size_t m_head = 0;
+		size_t m_tail = 0;
+	};
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "defines.h"
+#include "memoryCommands.h"
+#include <map>
+#include <string>
+#include <vector>
+#include <switch.h>
+
+namespace ScanCommands {
+	class Scanner : protected virtual MemoryCommands::Vision {
+	public:
+		Scanner() : Vision() {}
+		~Scanner() override {}
+
+	protected:
+		enum class ScanType {
+			U8,
+			U16,
+			U32,
+			U64,
+			F32,
+			F64,
+			Bytes,
+		};
+
+		enum class ScanMode {
+			Equals,
+			Changed,
+			Unchanged,
+			Increased,
+			Decreased,
+		};
+
+		void scanStart(ScanType type, std::string_view value, u64 start, u64 end, std::vector<char>& buffer);
+		void scanNext(ScanMode mode, std::string_view value, std::vector<char>& buffer);
+		void scanResults(u64 max, std::vector<char>& buffer);
+		void scanReset();
+
+		static bool parseScanType(std::string_view arg, ScanType& type);
+		static bool parseScanMode(std::string_view arg, ScanMode& mode);
+
+	private:
+		static constexpr size_t ScanCandidateCapacity = 0x4000;
+		static constexpr u64 ScanChunkSize = 0x10000;
+		static constexpr u64 ScanYieldSize = 0x100000; // Bytes read with the game paused before a scan lets it run again.
+
+		struct ScanState {
+			ScanType type = ScanType::U32;
+			std::vector<char> pattern;
+			u64 value = 0;
+			u64 pid = 0;
+			bool overflow = false;
+
+			// Candidate addresses in ascending order, and the value each held on the last pass (first 8 bytes for patterns).
+			std::vector<u64> addresses;
+			std::vector<u64> values;
+		};
+
+		ScanState& getScanState();
+		static bool parseScanValue(const ScanState& state, std::string_view arg, u64& value, std::vector<char>& pattern);
+		static u64 getScanWidth(const ScanState& state);
+		static bool compareScanValue(const ScanState& state, ScanMode mode, u64 current, u64 previous, u64 value);
+		static void scanChunk(ScanState& state, const char* data, size_t size, u64 address);
+		static void writeScanCount(const ScanState& state, std::vector<char>& buffer);
+
+		std::map<const ModuleBase::ClientSettings*, ScanState> m_scans; // One scan per client, keyed by its settings. Guarded by the debug mutex.
+	};
+}
@@ -3,6 +3,8 @@
 #include "defines.h"
 #include "lockFreeQueue.h"
 #include "connection.h"
+#include "udpChannel.h"
+#include <chrono>
 #include <string>
 #include <vector>
 #include <memory>
@@ -10,10 +12,15 @@
 namespace SocketConnection {
 	class SocketConnection : public Connection::ConnectionHandler {
 	public:
-		SocketConnection() : ConnectionHandler(), m_tcp(), m_senderQueue(), m_commandQueue() {
+		SocketConnection() : ConnectionHandler(), m_tcp(), m_senderQueue() {
 			m_error = false;
             m_stop = false;
 			m_handler = std::make_unique<CommandHandler::Handler>();
+			m_handler->setResponseStream([this](std::vector<char>&& chunk) { return pushResponseChunk(std::move(chunk)); });
+			m_handler->setCommandQueue(&m_commandQueue);
+			m_handler->setSendStats(&m_sendStats);
+			m_handler->cqSetFinishedSink([this](u64 seqnum) { return m_udp.sendFinished(seqnum); });
+			m_handler->watchSetEventSink([this](const ModuleBase::ClientSettings& client, std::vector<char>&& message) { return queueEvent(client, std::move(message)); });
 		};
 
 		~SocketConnection() override {
@@ -31,21 +38,64 @@ namespace SocketConnection {
 		int receiveData(int sockfd = 0) override;
 		int sendData(const char* data, size_t data_size, int sockfd) override;
 
+		static constexpr int Port = 6000;
+
 	private:
+		static constexpr size_t ResponseStreamDepth = 2; // Streamed chunks allowed in a client's send queue at once.
+		static constexpr size_t MaxClients = 8; // Further connections are refused until a client leaves.
+		static constexpr long SelectTimeoutUs = 100000; // Longest a select() blocks before re-checking for errors.
+
 		struct TcpConnection {
 			int serverFd = -1;
-			int clientFd = -1;
-			const int port = 6000;
+			const int port = Port;
+		};
+
+		// One connected client. Commands, replies and protocol settings are per client; the handler and its debug session are shared.
+		struct Client {
+			u32 id = 0;
+			int fd = -1;
+			std::string receiveBuffer;
+			std::shared_ptr<ModuleBase::ClientSettings> settings = std::make_shared<ModuleBase::ClientSettings>();
+			LocklessQueue::LockFreeQueue<std::vector<char>> sendQueue;
+			std::mutex sendMutex; // Held while writing to fd, so it can't be closed mid-send.
+			std::atomic_bool closed { false };
+			std::vector<char> lingering; // A lone reply held back for sendLinger, sender thread only.
+			std::chrono::steady_clock::time_point lingerDeadline;
 		};
 
 		TcpConnection m_tcp;
+		UdpChannel::Channel m_udp;
+		u16 m_udpPort = 0; // From config.cfg at initialize(), 0 if the UDP side channel is off.
 
 		int setupServerSocket();
 		void closeSocket();
+		void addClient(int fd);
+		void acceptClient();
+		void closeClient(const std::shared_ptr<Client>& client);
+		std::shared_ptr<Client> findClient(u32 id);
+		std::shared_ptr<Client> getEventClient();
+		std::vector<std::shared_ptr<Client>> getClients();
+		int receiveFromClient(Client& client);
+		bool sendBatch(Client& client, std::chrono::steady_clock::time_point& wake);
+		bool sendToClient(Client& client, std::vector<char>& buffer);
+		int waitWritable(int sockfd);
+		bool hasPendingSends();
+
+		bool pushResponseChunk(std::vector<char>&& chunk);
+		void queueResponse(std::vector<char>&& buffer, const std::string& requestId, u32 client);
+		void queueFrame(std::vector<char>&& buffer, u32 client);
+		bool queueEvent(const ModuleBase::ClientSettings& settings, std::vector<char>&& message);
+		void queueCommand(std::string&& command, PriorityQueue::Priority priority, u32 client);
+		void runLaneRequest(CommandLanes::Request& request, std::vector<std::string_view>& tokens);
+		void handleLaneRequest(CommandLanes::Request& request, std::vector<std::string_view>& tokens);
+		void queueLaneError(const CommandLanes::Request& request);
+		void startHandlerThreads(u32 client);
 		void notifyAll() {
 			m_commandCv.notify_all();
             m_senderCv.notify_all();
+			m_lanes.notifyAll();
 			if (m_handler) m_handler->cqNotifyAll();
+			if (m_handler) m_handler->watchNotifyAll();
 		}
 
 		bool getThreadsInitialized() const {
@@ -53,22 +103,30 @@ namespace SocketConnection {
 				   && m_commandInitialized.load(std::memory_order_relaxed);
         }
 
-		std::string m_persistentBuffer;
+		std::vector<std::shared_ptr<Client>> m_clients;
+		std::mutex m_clientsMutex;
+		u32 m_nextClientId = 1;
+		std::atomic<u32> m_eventClient { 0 }; // Receives controller queue replies. Watch events go to the client that registered the watch.
+		std::atomic<u32> m_streamClient { 0 }; // Owner of the command the command thread is running, for streamed replies.
+
 		std::atomic_bool m_senderInitialized { false };
 		std::atomic_bool m_commandInitialized { false };
 
 		std::thread m_senderThread;
-		LocklessQueue::LockFreeQueue<std::vector<char>> m_senderQueue;
+		CommandHandler::SendStats m_sendStats;
+		LocklessQueue::LockFreeQueue<std::vector<char>> m_senderQueue; // Unsolicited messages, sent to the event client.
 		std::mutex m_senderMutex;
 		std::condition_variable m_senderCv;
 
 		std::thread m_commandThread;
-		LocklessQueue::LockFreeQueue<std::string> m_commandQueue;
+		PriorityQueue::CommandQueue m_commandQueue;
 		std::mutex m_commandMutex;
 		std::condition_variable m_commandCv;
+		std::vector<std::string_view> m_receiveTokens; // Scratch tokens for the receive path, reused across lines.
 
 		std::atomic_bool m_error { false };
 		std::atomic_bool m_stop { false };
+		CommandLanes::Lanes m_lanes { m_stop, m_error };
 		std::unique_ptr<CommandHandler::Handler> m_handler;
 	};
 }
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "defines.h"
+#include "commandHandler.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <netinet/in.h>
+#include <switch.h>
+
+namespace UdpChannel {
+	/**
+	 * @brief Optional datagram endpoint for controller queue commands, so an input change never waits behind a large reply on the TCP stream.
+	 * Each datagram is "{seq} {command} [args]". Sequence numbers only increase; a replayed or reordered datagram is acknowledged again but not re-applied.
+	 */
+	class Channel {
+	public:
+		Channel() {}
+		~Channel() {
+			close();
+		}
+
+		Channel(const Channel&) = delete;
+		Channel& operator=(const Channel&) = delete;
+
+		bool open(u16 port);
+		void close();
+		void receive(CommandHandler::Handler& handler);
+		bool sendFinished(u64 seqnum);
+
+		int getFd() const {
+			return m_fd.load(std::memory_order_relaxed);
+		}
+
+	private:
+		static constexpr size_t MaxDatagram = 256;
+		static constexpr size_t MaxPending = 64; // Controller seqnums awaiting completion. Older ones were cancelled or replaced.
+
+		void handleDatagram(CommandHandler::Handler& handler, std::string_view datagram, const struct sockaddr_in& from);
+		void sendTo(const std::string& message, const struct sockaddr_in& peer);
+
+		std::atomic<int> m_fd { -1 };
+		std::vector<std::string_view> m_tokens; // Scratch tokens for the receive thread.
+
+		std::mutex m_mutex; // Guards the peer and sequence state between the receive and controller threads.
+		struct sockaddr_in m_peer {};
+		bool m_hasPeer = false;
+		u64 m_lastSeq = 0;
+		u64 m_lastFinished = 0;
+		std::deque<u64> m_pending;
+	};
+}
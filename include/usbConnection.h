@@ -3,6 +3,7 @@
 #include "defines.h"
 #include "lockFreeQueue.h"
 #include "connection.h"
+#include "receiveRing.h"
 #include <string>
 #include <vector>
 #include <memory>
@@ -14,18 +15,21 @@ namespace UsbConnection {
 			m_error = false;
 			m_stop = false;
 			m_handler = std::make_unique<CommandHandler::Handler>();
+			m_handler->setResponseStream([this](std::vector<char>&& chunk) { return pushResponseChunk(std::move(chunk)); });
+			m_handler->setCommandQueue(&m_commandQueue);
 		};
 
 		~UsbConnection() override {
 			m_error = true;
 			notifyAll();
 
-			m_persistentBuffer.clear();
+			m_receiveRing.clear();
 			m_senderQueue.clear();
 			m_commandQueue.clear();
 
 			if (m_senderThread.joinable()) m_senderThread.join();
 			if (m_commandThread.joinable()) m_commandThread.join();
+			m_lanes.join();
 			if (m_handler) m_handler.reset();
 		};
 
@@ -40,10 +44,28 @@ namespace UsbConnection {
 		int sendData(const char* data, size_t size, int sockfd = 0) override;
 
 	private:
+		static constexpr size_t ResponseStreamDepth = 2; // Streamed chunks allowed in the sender queue at once.
+		static constexpr size_t ReceiveRingSize = 0x10000; // Holds any command but large pokes and frames, which spill to the heap.
+		static constexpr size_t ReadChunkSize = 0x1000; // Most bytes asked of one usbCommsRead() when the size isn't announced.
+
+		size_t handleReceived(std::string_view data, bool& invalid);
+		void spillReceived();
+		bool drainReceived();
+
+		bool pushResponseChunk(std::vector<char>&& chunk);
+		void queueResponse(std::vector<char>&& buffer, const std::string& requestId);
+		void queueFrame(std::vector<char>&& buffer);
+		void queueCommand(std::string&& command, PriorityQueue::Priority priority);
+		void runLaneRequest(CommandLanes::Request& request, std::vector<std::string_view>& tokens);
+		void handleLaneRequest(CommandLanes::Request& request, std::vector<std::string_view>& tokens);
+		void queueLaneError(const CommandLanes::Request& request);
+		void startHandlerThreads();
 		void notifyAll() {
 			m_commandCv.notify_all();
 			m_senderCv.notify_all();
+			m_lanes.notifyAll();
 			if (m_handler) m_handler->cqNotifyAll();
+			if (m_handler) m_handler->watchNotifyAll();
 		}
 
 		bool getThreadsInitialized() const {
@@ -51,7 +73,8 @@ namespace UsbConnection {
 				&& m_commandInitialized.load(std::memory_order_relaxed);
 		}
 
-		std::string m_persistentBuffer;
+		ReceiveRing::Ring m_receiveRing { ReceiveRingSize };
+		std::string m_spill; // A command or frame too big for the ring, while it is being received.
 		std::atomic_bool m_senderInitialized { false };
 		std::atomic_bool m_commandInitialized { false };
 
@@ -61,12 +84,14 @@ namespace UsbConnection {
 		std::condition_variable m_senderCv;
 
 		std::thread m_commandThread;
-		LocklessQueue::LockFreeQueue<std::string> m_commandQueue;
+		PriorityQueue::CommandQueue m_commandQueue;
 		std::mutex m_commandMutex;
 		std::condition_variable m_commandCv;
+		std::vector<std::string_view> m_receiveTokens; // Scratch tokens for the receive path, reused across lines.
 
 		std::atomic_bool m_error { false };
 		std::atomic_bool m_stop{ false };
+		CommandLanes::Lanes m_lanes { m_stop, m_error };
 		std::unique_ptr<CommandHandler::Handler> m_handler;
 
 		struct USBResponse {
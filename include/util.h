@@ -2,13 +2,17 @@
 
 #include "defines.h"
 #include <vector>
+#include <span>
 #include <string>
-#include <functional>
+#include <string_view>
 #include <switch.h>
 
 namespace Util {
 	extern bool g_enableBackwardsCompat;
 
+	// Command arguments as views into the received line. Only valid until the handler returns.
+	using Args = std::span<const std::string_view>;
+
 	class Utils {
 	public:
 		Utils() {}
@@ -17,10 +21,36 @@ namespace Util {
 	public:
 		static bool flashLed();
 		static bool isUSB();
-		static void parseArgs(const std::string& cmd, std::function<void(const std::string&, const std::vector<std::string>&)> callback);
-		static u64 parseStringToInt(const std::string& arg);
-		static s64 parseStringToSignedLong(const std::string& arg);
-		static std::vector<char> parseStringToByteBuffer(const std::string& arg);
+		static std::string takeRequestId(std::string& cmd);
+		static void tokenize(std::string_view line, std::vector<std::string_view>& tokens);
+		static std::string_view firstToken(std::string_view line);
+		static std::string_view commandName(std::string_view line);
+		static bool parseInt(std::string_view arg, u64& value);
+		static bool parseSignedInt(std::string_view arg, s64& value);
+		static u64 parseStringToInt(std::string_view arg);
+		static s64 parseStringToSignedLong(std::string_view arg);
+		static bool parseByteBuffer(std::string_view arg, std::vector<char>& buffer);
+		static std::vector<char> parseStringToByteBuffer(std::string_view arg);
+
+		/**
+		 * @brief Split a command line and invoke the callback with the command name and its arguments.
+		 * @param The command line. The tokens are views into it, so it must outlive the callback.
+		 * @param Scratch storage for the tokens, reused across calls so steady-state parsing does not allocate.
+		 * @param Invoked as callback(std::string_view command, Args params) if the line holds a command.
+		 * @return false if the line was empty.
+		 */
+		template <typename Callback>
+		static bool parseArgs(std::string_view cmd, std::vector<std::string_view>& tokens, Callback&& callback) {
+			tokenize(cmd, tokens);
+			if (tokens.empty()) {
+				return false;
+			}
+
+			callback(tokens.front(), Args(tokens).subspan(1));
+			return true;
+		}
+		static void hexEncode(const char* src, size_t size, char* dst, bool flip = false);
+		static bool hexDecode(const char* src, size_t count, char* dst);
 		static void hexify(std::vector<char>& buffer, bool flip = false);
 		static void hexifyString(std::vector<char>& buffer, bool flip = false);
 
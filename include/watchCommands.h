@@ -0,0 +1,95 @@
+#pragma once
+
+#include "defines.h"
+#include "memoryCommands.h"
+#include "lockFreeQueue.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <switch.h>
+
+namespace WatchCommands {
+	using namespace LocklessQueue;
+
+	class Watcher : protected virtual MemoryCommands::Vision {
+	public:
+		Watcher() : Vision() {}
+		~Watcher() override {
+			watchJoinThread();
+		}
+
+	public:
+		using EventSink = std::function<bool(const ModuleBase::ClientSettings& client, std::vector<char>&& message)>; // Returns false if the client is gone or can't take it.
+
+		void startWatchThread(LockFreeQueue<std::vector<char>>& senderQueue, std::condition_variable& senderCv, std::atomic_bool& stop, std::atomic_bool& error);
+		bool getWatchPending();
+		void watchNotifyAll();
+		void watchJoinThread();
+		void watchSetEventSink(EventSink sink);
+
+	protected:
+		enum class WatchBase {
+			Heap,
+			Main,
+			Absolute,
+			Pointer,
+		};
+
+		struct WatchSpec {
+			WatchBase base = WatchBase::Heap;
+			s64 offset = 0; // Offset from the base, or the final jump of a pointer chain.
+			s64 mainJump = 0;
+			std::vector<s64> jumps;
+			u64 size = 0;
+			u64 intervalTicks = 0;
+		};
+
+		bool watchAdd(const std::string& id, const WatchSpec& spec);
+		bool watchRemove(const std::string& id);
+		void watchClear();
+
+		static bool parseWatchBase(std::string_view arg, WatchBase& base);
+
+	private:
+		static constexpr size_t WatchCapacity = 32;
+		static constexpr u64 WatchMaxSize = 0x100;
+
+		using WatchKey = std::pair<const ModuleBase::ClientSettings*, std::string>; // The owning client's settings and its watch id.
+
+		struct Watch {
+			WatchSpec spec;
+			u64 generation;
+			u64 nextTick;
+			std::vector<char> value;
+			bool hasValue;
+		};
+
+		struct WatchSample {
+			WatchKey key;
+			u64 generation;
+			WatchSpec spec;
+			std::vector<char> value;
+			bool valid;
+		};
+
+		void watchLoop(LockFreeQueue<std::vector<char>>& senderQueue, std::condition_variable& senderCv, std::atomic_bool& stop, std::atomic_bool& error);
+		void sampleWatches(std::vector<WatchSample>& samples);
+		u64 resolveWatchAddress(const WatchSpec& spec);
+
+		std::map<WatchKey, Watch> m_watches; // Each client's watches, so ids chosen by different clients don't collide.
+		u64 m_watchGeneration = 0;
+		bool m_watchesChanged = false;
+
+		std::thread m_watchThread;
+		std::mutex m_watchMutex;
+		std::condition_variable m_watchCv;
+		EventSink m_watchEventSink; // Set before the watch thread starts. Without one, events go to the sender queue.
+		std::atomic_bool m_watchThreadRunning { false };
+		std::atomic_bool m_watchStop { false };
+	};
+}
@@ -0,0 +1,760 @@
+#include "defines.h"
+#include "commandHandler.h"
+#include "bufferPool.h"
+#include "logger.h"
+#include "receiveRing.h"
+#include "socketConnection.h"
+#include "util.h"
+
+// On-device benchmarks, built only with "make BENCHMARKS=1" so they stay out of the release sysmodule.
+#if defined(SBB_BENCHMARKS)
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <malloc.h>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/errno.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+namespace CommandHandler {
+	using namespace SbbLog;
+	using namespace Util;
+	using namespace ModuleBase;
+	using namespace MemoryCommands;
+	using namespace ScanCommands;
+
+	/**
+	 * @brief Time one pass of a benchmark.
+	 * @param The pass.
+	 * @return How long it took, in nanoseconds.
+	 */
+	template<typename Pass>
+	static u64 timeNs(Pass&& pass) {
+		u64 start = armGetSystemTick();
+		pass();
+		return armTicksToNs(armGetSystemTick() - start);
+	}
+
+	/**
+	 * @brief Turn a count of operations done in a timed pass into a rate.
+	 * @param How many operations the pass did.
+	 * @param How long the pass took, in nanoseconds.
+	 * @return Operations per second, 0 if the pass took no measurable time.
+	 */
+	static u64 perSecond(u64 count, u64 ns) {
+		return ns == 0 ? 0 : count * 1000000000ULL / ns;
+	}
+
+	/**
+	 * @brief Turn the bytes processed in a timed pass into a throughput.
+	 * @param How many bytes the pass processed.
+	 * @param How long the pass took, in nanoseconds.
+	 * @return Megabytes per second, 0 if the pass took no measurable time.
+	 */
+	static u64 megabytesPerSecond(u64 bytes, u64 ns) {
+		return ns == 0 ? 0 : bytes * 1000ULL / ns;
+	}
+
+#pragma region Benchmark
+	/**
+	 * @brief Look up a "benchmark" subcommand.
+	 * @param The benchmark name.
+	 * @return The benchmark's handler, or nullptr if there is no such benchmark.
+	 */
+	const Handler::CmdFunc* Handler::findBenchmark(std::string_view name) {
+		static constexpr auto table = Dispatch::makeTable<std::string_view, CmdFunc>({
+			REGISTER_BENCH_CMD("attach", benchmarkAttach),
+			REGISTER_BENCH_CMD("peekMulti", benchmarkPeekMulti),
+			REGISTER_BENCH_CMD("compress", benchmarkCompress),
+			REGISTER_BENCH_CMD("parse", benchmarkParse),
+			REGISTER_BENCH_CMD("dispatch", benchmarkDispatch),
+			REGISTER_BENCH_CMD("hex", benchmarkHex),
+			REGISTER_BENCH_CMD("pool", benchmarkPool),
+			REGISTER_BENCH_CMD("clients", benchmarkClients),
+			REGISTER_BENCH_CMD("latency", benchmarkLatency),
+			REGISTER_BENCH_CMD("usbRing", benchmarkUsbRing)
+		});
+
+		return table.find(name);
+	}
+
+	/**
+	 * @brief Handle the "benchmark" command.
+	 * @param [name, args...].
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmark_cmd(Args params, std::vector<char>& buffer) {
+		if (params.empty()) {
+			return;
+		}
+
+		const CmdFunc* function = findBenchmark(params.front());
+		if (function) {
+			(*function)(*this, params.subspan(1), buffer);
+		} else {
+			Logger::instance().log("benchmark_cmd() benchmark not found (" + std::string(params.front()) + ").");
+		}
+	}
+
+	/**
+	 * @brief Compare reads/sec of attaching per read against reading through one debug session.
+	 * @param [absoluteOffset, size, iterations].
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmarkAttach(Args params, std::vector<char>& buffer) {
+		if (params.size() != 3) {
+			return;
+		}
+
+		u64 offset = Utils::parseStringToInt(params[0]);
+		u64 size = Utils::parseStringToInt(params[1]);
+		u64 iterations = Utils::parseStringToInt(params[2]);
+		if (size == 0 || size > MAX_LINE_LENGTH || iterations == 0) {
+			return;
+		}
+
+		// Only one debugger may be attached at a time, so release the command's handle for the per-read baseline.
+		closeDebugHandle();
+		std::vector<char> data(size);
+		u64 perReadNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				Handle handle = 0;
+				if (R_SUCCEEDED(svcDebugActiveProcess(&handle, m_metaData.pid))) {
+					svcReadDebugProcessMemory(data.data(), handle, offset, size);
+					svcCloseHandle(handle);
+				}
+			}
+		});
+
+		u64 sessionNs = timeNs([&]() {
+			DebugSession session(*this);
+			for (u64 i = 0; i < iterations; ++i) {
+				readMem(data, offset, size);
+			}
+		});
+
+		std::string res = "perRead=" + std::to_string(perSecond(iterations, perReadNs)) + " session=" + std::to_string(perSecond(iterations, sessionNs)) + "\r\n";
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+
+	/**
+	 * @brief Compare kernel calls and latency of one read per range against the coalesced multi-peek planner.
+	 * @param [iterations, absoluteOffset1, size1, absoluteOffset2, size2, ...].
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmarkPeekMulti(Args params, std::vector<char>& buffer) {
+		if (params.size() < 3) {
+			return;
+		}
+
+		u64 iterations = Utils::parseStringToInt(params[0]);
+		if (iterations == 0) {
+			return;
+		}
+
+		size_t itemCount = (params.size() - 1) / 2;
+		std::vector<u64> offsets(itemCount);
+		std::vector<u64> sizes(itemCount);
+		std::vector<u64> dest(itemCount);
+		u64 totalSize = 0;
+		for (size_t i = 0; i < itemCount; ++i) {
+			offsets[i] = Utils::parseStringToInt(params[(i * 2) + 1]);
+			sizes[i] = Utils::parseStringToInt(params[(i * 2) + 2]);
+			dest[i] = totalSize;
+			totalSize += sizes[i];
+		}
+
+		std::vector<char> data(totalSize);
+		u64 calls = m_kernelReadCount;
+		u64 naiveNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				for (size_t j = 0; j < itemCount; ++j) {
+					readMem(data, offsets[j], sizes[j], dest[j]);
+				}
+			}
+		});
+
+		u64 naiveCalls = m_kernelReadCount - calls;
+		calls = m_kernelReadCount;
+		u64 coalescedNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				readMulti(offsets, sizes, data);
+			}
+		});
+
+		u64 coalescedCalls = m_kernelReadCount - calls;
+
+		std::string res = "naiveCalls=" + std::to_string(naiveCalls / iterations) + " naiveUs=" + std::to_string(naiveNs / iterations / 1000)
+			+ " coalescedCalls=" + std::to_string(coalescedCalls / iterations) + " coalescedUs=" + std::to_string(coalescedNs / iterations / 1000) + "\r\n";
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+
+	/**
+	 * @brief Measure LZ4 ratio and throughput on a real memory block, raw and as the hex text WiFi sends in backwards compatibility mode.
+	 * @param [absoluteOffset, size, iterations].
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmarkCompress(Args params, std::vector<char>& buffer) {
+		if (params.size() != 3) {
+			return;
+		}
+
+		u64 offset = Utils::parseStringToInt(params[0]);
+		u64 size = Utils::parseStringToInt(params[1]);
+		u64 iterations = Utils::parseStringToInt(params[2]);
+		if (size == 0 || size > 0x40000 || iterations == 0) {
+			return;
+		}
+
+		std::vector<char> data;
+		if (R_FAILED(readRange(offset, size, data))) {
+			return;
+		}
+
+		std::vector<char> hex = data;
+		Utils::hexify(hex);
+
+		std::vector<char> compressed;
+		u64 compressNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				compressed.clear();
+				Compression::Lz4::compress(data.data(), data.size(), compressed);
+			}
+		});
+
+		std::vector<char> restored(size);
+		bool ok = true;
+		u64 decompressNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				ok &= Compression::Lz4::decompress(compressed.data(), compressed.size(), restored.data(), restored.size());
+			}
+		});
+
+		ok &= restored == data;
+
+		std::vector<char> hexCompressed;
+		Compression::Lz4::compress(hex.data(), hex.size(), hexCompressed);
+
+		char res[192];
+		int len = std::snprintf(res, sizeof(res), "raw=%lu compressed=%lu ratio=%.2f hex=%lu hexCompressed=%lu compressMBps=%lu decompressMBps=%lu ok=%d\r\n",
+			size, compressed.size(), (double)size / compressed.size(), hex.size(), hexCompressed.size(),
+			megabytesPerSecond(size * iterations, compressNs), megabytesPerSecond(size * iterations, decompressNs), ok ? 1 : 0);
+		buffer.insert(buffer.begin(), res, res + len);
+	}
+
+	/**
+	 * @brief Compare lines/sec of the string_view tokenizer against copying every token into a std::string.
+	 * @param [iterations].
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmarkParse(Args params, std::vector<char>& buffer) {
+		if (params.size() != 1) {
+			return;
+		}
+
+		u64 iterations = Utils::parseStringToInt(params[0]);
+		if (iterations == 0) {
+			return;
+		}
+
+		static constexpr std::string_view lines[] = {
+			"peek 0x4C2A8F10 8\r\n",
+			"pointerPeek 0x158 0x4E34DD0 0x18 0x30 0xD8 0x38\r\n",
+			"peekMulti 0x10 4 0x40 8 0x80 0x10\r\n",
+			"click A\r\n",
+			"setStick LEFT 0x7FFF -0x8000\r\n",
+		};
+
+		constexpr u64 lineCount = sizeof(lines) / sizeof(lines[0]);
+		volatile u64 sink = 0;
+		std::vector<std::string_view> tokens;
+		u64 viewNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				for (std::string_view line : lines) {
+					Utils::parseArgs(line, tokens, [&](std::string_view cmd, Args args) {
+						u64 sum = cmd.size();
+						for (std::string_view arg : args) {
+							s64 value = 0;
+							sum += Utils::parseSignedInt(arg, value) ? (u64)value : arg.size();
+						}
+
+						sink = sink + sum;
+					});
+				}
+			}
+		});
+
+		u64 copyNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				for (std::string_view line : lines) {
+					// The previous tokenizer: a std::string per token, then a second vector for the parameters.
+					std::vector<std::string> copies;
+					Utils::tokenize(line, tokens);
+					for (std::string_view token : tokens) {
+						copies.emplace_back(token);
+					}
+
+					std::string cmd = copies.front();
+					std::vector<std::string> args(copies.begin() + 1, copies.end());
+					u64 sum = cmd.size();
+					for (const std::string& arg : args) {
+						char* end = nullptr;
+						u64 value = std::strtoull(arg.c_str(), &end, 0);
+						sum += *end == '\0' ? value : arg.size();
+					}
+
+					sink = sink + sum;
+				}
+			}
+		});
+
+		std::string res = "views=" + std::to_string(perSecond(iterations * lineCount, viewNs)) + " copies=" + std::to_string(perSecond(iterations * lineCount, copyNs)) + "\r\n";
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+
+	/**
+	 * @brief Compare lookups/sec of the compile-time command table against a runtime std::unordered_map keyed by std::string.
+	 * @param [iterations].
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmarkDispatch(Args params, std::vector<char>& buffer) {
+		if (params.size() != 1) {
+			return;
+		}
+
+		u64 iterations = Utils::parseStringToInt(params[0]);
+		if (iterations == 0) {
+			return;
+		}
+
+		static constexpr std::string_view names[] = {
+			"peek", "peekMulti", "pointerPeek", "pokeAbsolute", "click", "setStick", "getTitleID", "configure", "pixelPeek", "unknownCommand",
+		};
+
+		constexpr u64 nameCount = sizeof(names) / sizeof(names[0]);
+		std::unordered_map<std::string, CmdFunc> map;
+		for (std::string_view name : names) {
+			const CmdFunc* function = findCommand(name);
+			if (function) {
+				map[std::string(name)] = *function;
+			}
+		}
+
+		volatile u64 found = 0;
+		u64 tableNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				for (std::string_view name : names) {
+					found = found + (findCommand(name) != nullptr);
+				}
+			}
+		});
+
+		u64 mapNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				for (std::string_view name : names) {
+					found = found + (map.find(std::string(name)) != map.end());
+				}
+			}
+		});
+
+		std::string res = "table=" + std::to_string(perSecond(iterations * nameCount, tableNs)) + " hashMap=" + std::to_string(perSecond(iterations * nameCount, mapNs)) + "\r\n";
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+
+	/**
+	 * @brief Compare MB/s of the hex encode/decode kernels against the previous per-byte push_back and std::stoull versions.
+	 * @param [size, iterations].
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmarkHex(Args params, std::vector<char>& buffer) {
+		if (params.size() != 2) {
+			return;
+		}
+
+		u64 size = Utils::parseStringToInt(params[0]);
+		u64 iterations = Utils::parseStringToInt(params[1]);
+		if (size == 0 || size > 0x40000 || iterations == 0) {
+			return;
+		}
+
+		std::vector<char> data(size);
+		for (u64 i = 0; i < size; ++i) {
+			data[i] = (char)((i * 0x9E3779B1) >> 13);
+		}
+
+		static const char hexDigits[] = "0123456789ABCDEF";
+		std::vector<char> hex;
+		u64 legacyEncodeNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				hex.clear();
+				hex.reserve(size * 2);
+				for (char c : data) {
+					hex.push_back(hexDigits[((u8)c >> 4) & 0xF]);
+					hex.push_back(hexDigits[(u8)c & 0xF]);
+				}
+			}
+		});
+
+		std::vector<char> encoded(size * 2);
+		u64 encodeNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				Utils::hexEncode(data.data(), size, encoded.data());
+			}
+		});
+
+		std::vector<char> decoded(size);
+		u64 legacyDecodeNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				char pair[3] = { 0 };
+				for (u64 j = 0; j < size; ++j) {
+					pair[0] = encoded[(j * 2)];
+					pair[1] = encoded[(j * 2) + 1];
+					decoded[j] = (char)std::stoull(pair, NULL, 16);
+				}
+			}
+		});
+
+		bool ok = hex == encoded && decoded == data;
+		u64 decodeNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				ok &= Utils::hexDecode(encoded.data(), size, decoded.data());
+			}
+		});
+
+		ok &= decoded == data;
+
+		u64 bytes = size * iterations;
+		char res[160];
+		int len = std::snprintf(res, sizeof(res), "legacyEncodeMBps=%lu encodeMBps=%lu legacyDecodeMBps=%lu decodeMBps=%lu ok=%d\r\n",
+			megabytesPerSecond(bytes, legacyEncodeNs), megabytesPerSecond(bytes, encodeNs), megabytesPerSecond(bytes, legacyDecodeNs), megabytesPerSecond(bytes, decodeNs), ok ? 1 : 0);
+		buffer.insert(buffer.begin(), res, res + len);
+	}
+
+	/**
+	 * @brief Soak the heap with a command-like allocation pattern, once through the response buffer pool and once with a fresh vector per response,
+	 * and report how far the heap grew and how many free bytes were stranded inside it after the warm-up tenth of the run.
+	 * Short-lived strings of varying sizes are interleaved with the responses, like the log lines and command strings of a real session.
+	 * @param [iterations].
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmarkPool(Args params, std::vector<char>& buffer) {
+		if (params.size() != 1) {
+			return;
+		}
+
+		u64 iterations = Utils::parseStringToInt(params[0]);
+		if (iterations < 10) {
+			return;
+		}
+
+		// Mostly small text replies, some metadata and streamed peek chunks, the odd large compressed read.
+		static constexpr size_t ResponseSizes[] = { 3, 17, 9, 0x200, 5, 0x800, 33, 0xAC01, 12, 0x2000, 7, 0x1001, 64, 0x300, 2, 0x30000 };
+		std::array<std::string, 32> interleaved;
+		auto& pool = BufferPool::Pool::instance();
+		auto soak = [&](bool pooled, size_t& arenaGrowth, size_t& freeBytes) {
+			size_t warmArena = 0;
+			for (u64 i = 0; i < iterations; ++i) {
+				if (i == iterations / 10) {
+					warmArena = mallinfo().arena;
+				}
+
+				u64 hash = i * 0x9E3779B97F4A7C15ULL;
+				size_t size = ResponseSizes[(hash >> 60) & 0xF];
+				std::vector<char> response = pooled ? pool.acquire(size) : std::vector<char>();
+				response.resize(size, (char)i);
+				interleaved[i % interleaved.size()].assign(16 + ((hash >> 32) & 0xFF), 'x');
+				if (pooled) {
+					pool.release(std::move(response));
+				}
+			}
+
+			struct mallinfo info = mallinfo();
+			arenaGrowth = info.arena - warmArena;
+			freeBytes = info.fordblks;
+		};
+
+		auto before = pool.getStats();
+		size_t pooledGrowth = 0, pooledFree = 0;
+		u64 pooledNs = timeNs([&]() { soak(true, pooledGrowth, pooledFree); });
+		auto after = pool.getStats();
+
+		size_t heapGrowth = 0, heapFree = 0;
+		u64 heapNs = timeNs([&]() { soak(false, heapGrowth, heapFree); });
+
+		char res[256];
+		int len = std::snprintf(res, sizeof(res), "pooled=%lu/s arenaGrowth=%lu freeBytes=%lu hits=%lu misses=%lu\r\nheap=%lu/s arenaGrowth=%lu freeBytes=%lu\r\n",
+			perSecond(iterations, pooledNs), (u64)pooledGrowth, (u64)pooledFree, after.hits - before.hits, after.misses - before.misses,
+			perSecond(iterations, heapNs), (u64)heapGrowth, (u64)heapFree);
+		buffer.insert(buffer.begin(), res, res + len);
+	}
+
+	/**
+	 * @brief Connect 1, 2 and then 4 loopback clients to the socket server, have each ping it in lockstep, and report the aggregate round trips per second.
+	 * Send it tagged so it runs on a lane worker; untagged it blocks the command thread that has to answer the pings. Socket connections only.
+	 * @param [pings per client].
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmarkClients(Args params, std::vector<char>& buffer) {
+		if (params.size() != 1 || Utils::isUSB()) {
+			return;
+		}
+
+		u64 pings = Utils::parseStringToInt(params[0]);
+		if (pings == 0) {
+			return;
+		}
+
+		// Non-blocking, so a waiting client doesn't hold one of the few BSD sessions the server needs to answer it.
+		auto pingLoop = [pings](std::atomic<u64>& completed) {
+			int fd = socket(AF_INET, SOCK_STREAM, 0);
+			if (fd < 0) {
+				return;
+			}
+
+			struct sockaddr_in addr {};
+			addr.sin_family = AF_INET;
+			addr.sin_port = htons(SocketConnection::SocketConnection::Port);
+			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			int flags = 1;
+			if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || ioctl(fd, FIONBIO, &flags) < 0) {
+				close(fd);
+				return;
+			}
+
+			char line[32];
+			char reply[64];
+			for (u64 i = 0; i < pings; ++i) {
+				int len = std::snprintf(line, sizeof(line), "ping %lu\r\n", i);
+				if (send(fd, line, len, 0) != len) {
+					break;
+				}
+
+				size_t received = 0;
+				u64 deadline = armGetSystemTick() + armNsToTicks(2000000000ULL);
+				while (std::memchr(reply, '\n', received) == nullptr && received < sizeof(reply) && armGetSystemTick() < deadline) {
+					ssize_t n = recv(fd, reply + received, sizeof(reply) - received, 0);
+					if (n > 0) {
+						received += n;
+					} else if (n == 0 || (errno != EWOULDBLOCK && errno != EAGAIN)) {
+						break;
+					} else {
+						svcSleepThread(20000);
+					}
+				}
+
+				if (std::memchr(reply, '\n', received) == nullptr) {
+					break;
+				}
+
+				completed++;
+			}
+
+			close(fd);
+		};
+
+		std::string res;
+		for (size_t clients : { 1, 2, 4 }) {
+			std::atomic<u64> completed { 0 };
+			u64 ns = timeNs([&]() {
+				std::vector<std::thread> threads;
+				for (size_t i = 0; i < clients; ++i) {
+					threads.emplace_back(pingLoop, std::ref(completed));
+				}
+
+				for (auto& thread : threads) {
+					thread.join();
+				}
+			});
+
+			u64 expected = pings * clients;
+			res += "clients=" + std::to_string(clients) + " pings/s=" + std::to_string(perSecond(completed, ns));
+			res += completed == expected ? "\r\n" : " failed=" + std::to_string(expected - completed) + "\r\n";
+		}
+
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+
+	/**
+	 * @brief Ping the socket server over one loopback connection and report p50/p99 round-trip times, once waiting for each reply
+	 * with the 1 ms sleep-and-retry loop the server used to read and write with (sleep), and once blocking in select() until it arrives (select).
+	 * Send it tagged so it runs on a lane worker; untagged it blocks the command thread that has to answer the pings. Socket connections only.
+	 * @param [pings].
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmarkLatency(Args params, std::vector<char>& buffer) {
+		if (params.size() != 1 || Utils::isUSB()) {
+			return;
+		}
+
+		u64 pings = Utils::parseStringToInt(params[0]);
+		if (pings == 0) {
+			return;
+		}
+
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0) {
+			return;
+		}
+
+		struct sockaddr_in addr {};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(SocketConnection::SocketConnection::Port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		int opt = 1;
+		if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || ioctl(fd, FIONBIO, &opt) < 0) {
+			close(fd);
+			return;
+		}
+
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+		auto measure = [&](bool sleepPoll, u64& p50, u64& p99) {
+			std::vector<u64> samples;
+			samples.reserve(pings);
+			char line[32];
+			char reply[64];
+			for (u64 i = 0; i < pings; ++i) {
+				int len = std::snprintf(line, sizeof(line), "ping %lu\r\n", i);
+				u64 start = armGetSystemTick();
+				if (send(fd, line, len, 0) != len) {
+					break;
+				}
+
+				size_t received = 0;
+				u64 deadline = start + armNsToTicks(2000000000ULL);
+				while (std::memchr(reply, '\n', received) == nullptr && received < sizeof(reply) && armGetSystemTick() < deadline) {
+					ssize_t n = recv(fd, reply + received, sizeof(reply) - received, 0);
+					if (n > 0) {
+						received += n;
+						continue;
+					} else if (n == 0 || (errno != EWOULDBLOCK && errno != EAGAIN)) {
+						break;
+					}
+
+					if (sleepPoll) {
+						svcSleepThread(1e+6L);
+					} else {
+						fd_set readfds;
+						FD_ZERO(&readfds);
+						FD_SET(fd, &readfds);
+						struct timeval timeout { 0, 100000 };
+						select(fd + 1, &readfds, nullptr, nullptr, &timeout);
+					}
+				}
+
+				if (std::memchr(reply, '\n', received) == nullptr) {
+					break;
+				}
+
+				samples.push_back(armTicksToNs(armGetSystemTick() - start) / 1000);
+			}
+
+			std::sort(samples.begin(), samples.end());
+			p50 = samples.empty() ? 0 : samples[samples.size() / 2];
+			p99 = samples.empty() ? 0 : samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+			return samples.size();
+		};
+
+		u64 sleepP50 = 0, sleepP99 = 0, selectP50 = 0, selectP99 = 0;
+		size_t sleepCount = measure(true, sleepP50, sleepP99);
+		size_t selectCount = measure(false, selectP50, selectP99);
+		close(fd);
+
+		char res[160];
+		int len = std::snprintf(res, sizeof(res), "sleep p50=%luus p99=%luus pings=%lu\r\nselect p50=%luus p99=%luus pings=%lu\r\n",
+			sleepP50, sleepP99, (u64)sleepCount, selectP50, selectP99, (u64)selectCount);
+		buffer.insert(buffer.begin(), res, res + len);
+	}
+
+	/**
+	 * @brief Feed a stream of typical text commands through the USB receive path and report commands/sec into a command queue,
+	 * once through the fixed receive ring parsed in place (ring) and once through the old path (legacy): a fresh 4 KiB vector per read,
+	 * appended to a growing string that is searched and erased from the front. Reads are 4 KiB copies out of the stream, standing in for usbCommsRead().
+	 * @param [iterations], passes over a 64 KiB stream.
+	 * @param Output buffer for result.
+	 */
+	void Handler::benchmarkUsbRing(Args params, std::vector<char>& buffer) {
+		if (params.size() != 1) {
+			return;
+		}
+
+		u64 iterations = Utils::parseStringToInt(params[0]);
+		if (iterations == 0) {
+			return;
+		}
+
+		static constexpr std::string_view Commands[] = {
+			"peek 0x4E34DD0 8\r\n", "click A\r\n", "#12 peekMulti 0x10 4 0x80 8\r\n", "poke 0x2000 0x0102030405060708\r\n",
+			"pointerPeek 8 0x4E34DD0 0x18 0x30\r\n", "getTitleID\r\n", "setStick LEFT 0x7FFF 0\r\n", "#13 peekAbsolute 0x8000000 0x40\r\n",
+		};
+
+		std::string stream;
+		size_t perPass = 0;
+		while (stream.size() < 0x10000) {
+			stream.append(Commands[perPass++ % std::size(Commands)]);
+		}
+
+		static constexpr size_t ReadSize = 0x1000;
+		PriorityQueue::CommandQueue queue;
+		std::string popped;
+		Priority priority;
+		u32 client;
+		auto deliver = [&](std::string&& command) {
+			queue.push(getReceivePriority(command), std::move(command));
+			queue.pop(popped, priority, client);
+		};
+
+		ReceiveRing::Ring ring(0x10000);
+		u64 ringNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				for (size_t offset = 0; offset < stream.size(); offset += ReadSize) {
+					size_t available = 0;
+					char* space = ring.writeSpace(available);
+					size_t size = std::min({ ReadSize, available, stream.size() - offset });
+					std::memcpy(space, stream.data() + offset, size);
+					ring.commit(size);
+
+					std::string_view data = ring.readable();
+					std::string_view line;
+					size_t consumed = 0;
+					while (ReceiveRing::Ring::takeLine(data, consumed, line)) {
+						deliver(std::string(line));
+					}
+
+					ring.consume(consumed);
+				}
+			}
+		});
+
+		std::string persistent;
+		u64 legacyNs = timeNs([&]() {
+			for (u64 i = 0; i < iterations; ++i) {
+				for (size_t offset = 0; offset < stream.size(); offset += ReadSize) {
+					std::vector<char> buf(ReadSize);
+					size_t size = std::min(ReadSize, stream.size() - offset);
+					std::memcpy(buf.data(), stream.data() + offset, size);
+					persistent.append(buf.data(), size);
+
+					size_t pos;
+					while ((pos = persistent.find("\r\n")) != std::string::npos) {
+						auto cmd = persistent.substr(0, pos + 2);
+						persistent.erase(0, pos + 2);
+						deliver(std::move(cmd));
+					}
+				}
+			}
+		});
+
+		u64 total = perPass * iterations;
+		char res[128];
+		int len = std::snprintf(res, sizeof(res), "ring=%lu/s legacy=%lu/s commands=%lu\r\n", perSecond(total, ringNs), perSecond(total, legacyNs), total);
+		buffer.insert(buffer.begin(), res, res + len);
+	}
+#pragma endregion On-device benchmarks.
+}
+#endif
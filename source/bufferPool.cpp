@@ -0,0 +1,112 @@
+#include "defines.h"
+#include "bufferPool.h"
+
+namespace BufferPool {
+    /**
+     * @brief Get an empty buffer with room for at least size bytes, reusing a released one when possible.
+     * @param The number of bytes the caller expects to write. 0 asks for the smallest class.
+     * @return The buffer. Its contents are cleared; its capacity is at least size.
+     */
+    std::vector<char> Pool::acquire(size_t size) {
+        std::vector<char> buffer;
+        int index = classForSize(size);
+        if (index < 0) {
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            buffer.reserve(size);
+            return buffer;
+        }
+
+        if (m_free[index].pop(buffer)) {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            m_pooledBytes.fetch_sub(buffer.capacity(), std::memory_order_relaxed);
+            buffer.clear();
+            return buffer;
+        }
+
+        // New buffers are allocated at the class size, so the heap sees a handful of recurring block sizes instead of every response length.
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        buffer.reserve(ClassSizes[index]);
+        return buffer;
+    }
+
+    /**
+     * @brief Return a buffer once it has been sent. Buffers too small or too large for any class, or beyond the pool's byte cap, are freed.
+     * @param The buffer.
+     */
+    void Pool::release(std::vector<char>&& buffer) {
+        size_t capacity = buffer.capacity();
+        int index = classForCapacity(capacity);
+        if (index < 0) {
+            std::vector<char>().swap(buffer);
+            return;
+        }
+
+        u64 pooled = m_pooledBytes.fetch_add(capacity, std::memory_order_relaxed) + capacity;
+        if (pooled > MaxPooledBytes || !m_free[index].push(std::move(buffer))) {
+            m_pooledBytes.fetch_sub(capacity, std::memory_order_relaxed);
+            m_drops.fetch_add(1, std::memory_order_relaxed);
+            std::vector<char>().swap(buffer);
+            return;
+        }
+
+        u64 peak = m_peakBytes.load(std::memory_order_relaxed);
+        while (pooled > peak && !m_peakBytes.compare_exchange_weak(peak, pooled, std::memory_order_relaxed)) {}
+    }
+
+    /**
+     * @brief Make sure a buffer can hold size bytes without reallocating, swapping in a pooled buffer if it can't. Contents are kept.
+     * @param[out] The buffer.
+     * @param The number of bytes it needs to hold.
+     */
+    void Pool::reserve(std::vector<char>& buffer, size_t size) {
+        if (buffer.capacity() >= size) {
+            return;
+        }
+
+        std::vector<char> pooled = acquire(size);
+        pooled.assign(buffer.begin(), buffer.end());
+        buffer.swap(pooled);
+        release(std::move(pooled));
+    }
+
+    Pool::Stats Pool::getStats() const {
+        return Stats {
+            m_hits.load(std::memory_order_relaxed),
+            m_misses.load(std::memory_order_relaxed),
+            m_drops.load(std::memory_order_relaxed),
+            m_pooledBytes.load(std::memory_order_relaxed),
+            m_peakBytes.load(std::memory_order_relaxed),
+        };
+    }
+
+    /**
+     * @brief The smallest class whose buffers are all large enough for size.
+     * @return The class index, or -1 if size is larger than every class.
+     */
+    int Pool::classForSize(size_t size) {
+        for (size_t i = 0; i < ClassSizes.size(); ++i) {
+            if (size <= ClassSizes[i]) {
+                return (int)i;
+            }
+        }
+
+        return -1;
+    }
+
+    /**
+     * @brief The largest class a buffer of this capacity can serve. Buffers over twice the largest class are not kept.
+     * @return The class index, or -1 if the buffer shouldn't be pooled.
+     */
+    int Pool::classForCapacity(size_t capacity) {
+        if (capacity < ClassSizes.front() || capacity > ClassSizes.back() * 2) {
+            return -1;
+        }
+
+        int index = 0;
+        while (index + 1 < (int)ClassSizes.size() && capacity >= ClassSizes[index + 1]) {
+            ++index;
+        }
+
+        return index;
+    }
+}
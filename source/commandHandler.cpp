@@ -1,34 +1,40 @@
 #include "defines.h"
 #include "commandHandler.h"
+#include "bufferPool.h"
+#include "config.h"
 #include "logger.h"
 #include "util.h"
 #include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <optional>
 
 namespace CommandHandler {
 	using namespace SbbLog;
 	using namespace Util;
 	using namespace ModuleBase;
 	using namespace MemoryCommands;
+	using namespace ScanCommands;
 
 	/**
 	 * @brief Handles a command by name and parameters, dispatching to the appropriate handler.
 	 * @param The command name.
 	 * @param The command parameters.
+	 * @param false when running on a lane worker, where streamed chunks could interleave with other lanes' replies. Large peeks are then returned whole.
 	 * @return The result buffer.
 	 */
-	std::vector<char> Handler::HandleCommand(const std::string& cmd, const std::vector<std::string>& params) {
-		std::vector<char> buffer;
+	std::vector<char> Handler::HandleCommand(std::string_view cmd, Args params, bool allowStream) {
+		std::vector<char> buffer = BufferPool::Pool::instance().acquire();
 		if (cmd.empty()) {
 			Logger::instance().log("HandleCommand() cmd empty.");
 			return buffer;
 		}
 
-		std::string log = "HandleCommand cmd: " + cmd;
+		std::string log = "HandleCommand cmd: " + std::string(cmd);
 		if (!params.empty()) {
 			log += ". Parameters: ";
 			for (size_t i = 0; i < params.size(); ++i) {
-				log += "[" + std::to_string(i) + "]: " + params[i];
+				log += "[" + std::to_string(i) + "]: " + std::string(params[i]);
 				if (i < params.size() - 1) {
 					log += ", ";
 				}
@@ -36,30 +42,298 @@ namespace CommandHandler {
         }
 
         Logger::instance().log(log);
-		u64 pid = 0;
-		Result rc = pmdmntGetApplicationProcessId(&pid);
-		if (R_SUCCEEDED(rc)) {
-			m_metaData.pid = pid;
-			initMetaData();
-        }
+		std::optional<DebugSession> session;
+		std::optional<WholeReads> wholeReads;
+		if (needsDebugSession(getLane(cmd)) && getPriority(cmd) == Priority::Bulk) {
+			session.emplace(static_cast<BaseCommands&>(*this));
+			updateApplicationMetaData();
+			if (!allowStream) {
+				wholeReads.emplace(static_cast<Vision&>(*this), true);
+			}
+		}
 
-		auto it = Handler::m_cmd.find(cmd);
-		if (it != Handler::m_cmd.end()) {
-			it->second(params, buffer);
+		const CmdFunc* function = findCommand(cmd);
+		if (function) {
+			(*function)(*this, params, buffer);
 		} else {
-			Logger::instance().log("HandleCommand() cmd not found (" + cmd + ").");
+			Logger::instance().log("HandleCommand() cmd not found (" + std::string(cmd) + ").");
 		}
 
 		return buffer;
 	}
 
+#pragma region Register
+	/**
+	 * @brief Look up a text command.
+	 * @param The command name.
+	 * @return The command's handler, or nullptr if there is no such command.
+	 */
+	const Handler::CmdFunc* Handler::findCommand(std::string_view name) {
+		static constexpr auto table = Dispatch::makeTable<std::string_view, CmdFunc>({
+			REGISTER_CMD("peek", peek_cmd),
+			REGISTER_CMD("peekMulti", peekMulti_cmd),
+			REGISTER_CMD("peekAbsolute", peekAbsolute_cmd),
+			REGISTER_CMD("peekAbsoluteMulti", peekAbsoluteMulti_cmd),
+			REGISTER_CMD("peekMain", peekMain_cmd),
+			REGISTER_CMD("peekMainMulti", peekMainMulti_cmd),
+			REGISTER_CMD("peekDelta", peekDelta_cmd),
+			REGISTER_CMD("peekDeltaAbsolute", peekDeltaAbsolute_cmd),
+			REGISTER_CMD("peekDeltaMain", peekDeltaMain_cmd),
+			REGISTER_CMD_NOARGS("peekDeltaClear", peekDeltaClear_cmd),
+
+			REGISTER_CMD_PARAMS("poke", poke_cmd),
+			REGISTER_CMD_PARAMS("pokeAbsolute", pokeAbsolute_cmd),
+			REGISTER_CMD_PARAMS("pokeMain", pokeMain_cmd),
+
+			REGISTER_CMD("pointerAll", pointerAll_cmd),
+			REGISTER_CMD("pointerRelative", pointerRelative_cmd),
+			REGISTER_CMD("pointerPeek", pointerPeek_cmd),
+			REGISTER_CMD("pointerPeekMulti", pointerPeekMulti_cmd),
+			REGISTER_CMD_PARAMS("pointerPoke", pointerPoke_cmd),
+			REGISTER_CMD_BUFFER("regionMap", regionMap_cmd),
+
+			REGISTER_CMD("scanStart", scanStart_cmd),
+			REGISTER_CMD("scanNext", scanNext_cmd),
+			REGISTER_CMD("scanResults", scanResults_cmd),
+			REGISTER_CMD_NOARGS("scanReset", scanReset_cmd),
+
+			REGISTER_CMD_PARAMS("watchAdd", watchAdd_cmd),
+			REGISTER_CMD_PARAMS("watchRemove", watchRemove_cmd),
+
+			REGISTER_CMD_PARAMS("click", click_cmd),
+			REGISTER_CMD_PARAMS("press", press_cmd),
+			REGISTER_CMD_PARAMS("release", release_cmd),
+			REGISTER_CMD_PARAMS("setStick", setStick_cmd),
+			REGISTER_CMD_PARAMS("touch", touch_cmd),
+			REGISTER_CMD_PARAMS("touchHold", touchHold_cmd),
+			REGISTER_CMD_PARAMS("touchDraw", touchDraw_cmd),
+			REGISTER_CMD_PARAMS("key", key_cmd),
+			REGISTER_CMD_PARAMS("keyMod", keyMod_cmd),
+			REGISTER_CMD_PARAMS("keyMulti", keyMulti_cmd),
+			REGISTER_CMD_NOARGS("detachController", detachController_cmd),
+
+			REGISTER_CMD_BUFFER("getBuildID", getBuildID_cmd),
+			REGISTER_CMD_BUFFER("getTitleVersion", getTitleVersion_cmd),
+			REGISTER_CMD_BUFFER("getSystemLanguage", getSystemLanguage_cmd),
+			REGISTER_CMD("isProgramRunning", isProgramRunning_cmd),
+			REGISTER_CMD_BUFFER("getMainNsoBase", getMainNsoBase_cmd),
+			REGISTER_CMD_BUFFER("getHeapBase", getHeapBase_cmd),
+			REGISTER_CMD_BUFFER("charge", charge_cmd),
+			REGISTER_CMD_BUFFER("getVersion", getVersion_cmd),
+			REGISTER_CMD_BUFFER("getTitleID", getTitleID_cmd),
+			REGISTER_CMD("game", game_cmd),
+			REGISTER_CMD_PARAMS("configure", configure_cmd),
+			REGISTER_CMD_NOARGS("screenOn", screenOn_cmd),
+			REGISTER_CMD_NOARGS("screenOff", screenOff_cmd),
+			REGISTER_CMD_BUFFER("pixelPeek", pixelPeek_cmd),
+			REGISTER_CMD("ping", ping_cmd),
+			REGISTER_CMD_BUFFER("reloadConfig", reloadConfig_cmd),
+			REGISTER_CMD_BUFFER("barrier", barrier_cmd),
+
+			REGISTER_CMD_BUFFER("getSwitchTime", getSwitchTime_cmd),
+			REGISTER_CMD("setSwitchTime", setSwitchTime_cmd),
+			REGISTER_CMD_BUFFER("resetSwitchTime", resetSwitchTime_cmd),
+
+			REGISTER_CMD_NOARGS("debugSessionBegin", debugSessionBegin_cmd),
+			REGISTER_CMD_NOARGS("debugSessionEnd", debugSessionEnd_cmd),
+			REGISTER_CMD("exec", exec_cmd),
+#if defined(SBB_BENCHMARKS)
+			REGISTER_CMD("benchmark", benchmark_cmd),
+#endif
+			REGISTER_CMD("stats", stats_cmd),
+
+			REGISTER_CMD("protocol", protocol_cmd)
+		});
+
+		return table.find(name);
+	}
+
+	/**
+	 * @brief Look up a "stats" subcommand.
+	 * @param The stats name.
+	 * @return The stats handler, or nullptr if there are no such stats.
+	 */
+	const Handler::StatsFunc* Handler::findStats(std::string_view name) {
+		static constexpr auto table = Dispatch::makeTable<std::string_view, StatsFunc>({
+			REGISTER_STATS_CMD("metaCache", statsMetaCache),
+			REGISTER_STATS_CMD("pointerCache", statsPointerCache),
+			REGISTER_STATS_CMD("bufferPool", statsBufferPool),
+			REGISTER_STATS_CMD("queues", statsQueues),
+			REGISTER_STATS_CMD("sends", statsSends)
+		});
+
+		return table.find(name);
+	}
+
+	/**
+	 * @brief Look up a binary protocol opcode.
+	 * @param The opcode.
+	 * @return The frame handler, or nullptr if the opcode is unknown.
+	 */
+	const Handler::FrameFunc* Handler::findFrame(u16 opcode) {
+		static constexpr auto table = Dispatch::makeTable<u16, FrameFunc>({
+			REGISTER_FRAME_CMD(Protocol::Opcode::Command, frameCommand),
+			REGISTER_FRAME_CMD(Protocol::Opcode::Peek, framePeek),
+			REGISTER_FRAME_CMD(Protocol::Opcode::PeekMulti, framePeekMulti),
+			REGISTER_FRAME_CMD(Protocol::Opcode::Poke, framePoke),
+			REGISTER_FRAME_CMD(Protocol::Opcode::PointerPeek, framePointerPeek)
+		});
+
+		return table.find(opcode);
+	}
+
+	/**
+	 * @brief Classify a command into the lane a tagged request runs on. Commands not listed run on the system lane.
+	 * @param The command name.
+	 * @return The lane.
+	 */
+	Lane Handler::getLane(std::string_view cmd) {
+		static constexpr auto table = Dispatch::makeTable<std::string_view, Lane>({
+			{ "peek", Lane::Memory },
+			{ "peekMulti", Lane::Memory },
+			{ "peekAbsolute", Lane::Memory },
+			{ "peekAbsoluteMulti", Lane::Memory },
+			{ "peekMain", Lane::Memory },
+			{ "peekMainMulti", Lane::Memory },
+			{ "peekDelta", Lane::Memory },
+			{ "peekDeltaAbsolute", Lane::Memory },
+			{ "peekDeltaMain", Lane::Memory },
+			{ "peekDeltaClear", Lane::Memory },
+			{ "poke", Lane::Memory },
+			{ "pokeAbsolute", Lane::Memory },
+			{ "pokeMain", Lane::Memory },
+			{ "pointerAll", Lane::Memory },
+			{ "pointerRelative", Lane::Memory },
+			{ "pointerPeek", Lane::Memory },
+			{ "pointerPeekMulti", Lane::Memory },
+			{ "pointerPoke", Lane::Memory },
+			{ "regionMap", Lane::Memory },
+			{ "scanStart", Lane::Memory },
+			{ "scanNext", Lane::Memory },
+			{ "scanResults", Lane::Memory },
+			{ "scanReset", Lane::Memory },
+			{ "watchAdd", Lane::Memory },
+			{ "watchRemove", Lane::Memory },
+			{ "getMainNsoBase", Lane::Memory },
+			{ "getHeapBase", Lane::Memory },
+			{ "getBuildID", Lane::Memory },
+			{ "getTitleVersion", Lane::Memory },
+			{ "getTitleID", Lane::Memory },
+			{ "isProgramRunning", Lane::Memory },
+			{ "game", Lane::Memory },
+			{ "debugSessionBegin", Lane::Memory },
+			{ "debugSessionEnd", Lane::Memory },
+
+			{ "click", Lane::Input },
+			{ "press", Lane::Input },
+			{ "release", Lane::Input },
+			{ "setStick", Lane::Input },
+			{ "touch", Lane::Input },
+			{ "touchHold", Lane::Input },
+			{ "touchDraw", Lane::Input },
+			{ "key", Lane::Input },
+			{ "keyMod", Lane::Input },
+			{ "keyMulti", Lane::Input },
+			{ "detachController", Lane::Input },
+
+			{ "pixelPeek", Lane::Capture },
+			{ "screenOn", Lane::Capture },
+			{ "screenOff", Lane::Capture },
+
+			{ "exec", Lane::Barrier },
+			{ "protocol", Lane::Barrier },
+			{ "barrier", Lane::Barrier }
+		});
+
+		const Lane* lane = table.find(cmd);
+		return lane ? *lane : Lane::System;
+	}
+
+	/**
+	 * @brief Classify a binary protocol frame. Untagged frames are barriers, since the client can't match a reply that arrives out of order.
+	 * @param The whole frame, header included.
+	 * @return The lane of the passed-through command for command frames, Lane::Memory for the other memory opcodes.
+	 */
+	Lane Handler::getFrameLane(const std::string& frame) {
+		Protocol::FrameHeader header;
+		std::memcpy(&header, frame.data(), sizeof(header));
+		if (header.requestId == 0 || header.opcode == Protocol::Opcode::SetProtocol) {
+			return Lane::Barrier;
+		}
+
+		if (header.opcode == Protocol::Opcode::Command) {
+			return getLane(Utils::firstToken(std::string_view(frame).substr(sizeof(header))));
+		}
+
+		return Lane::Memory;
+	}
+
+	/**
+	 * @brief Classify a command. Urgent commands are cheap, don't need the debug handle and don't touch state owned by a lane
+	 * (detachController frees the input work buffer, so it stays bulk on the input lane). Tagged, they are popped ahead of every queued bulk command.
+	 * @param The command name.
+	 * @return The priority.
+	 */
+	Priority Handler::getPriority(std::string_view cmd) {
+		static constexpr auto table = Dispatch::makeTable<std::string_view, Priority>({
+			{ "ping", Priority::Urgent },
+			{ "getVersion", Priority::Urgent },
+			{ "getSwitchTime", Priority::Urgent },
+			{ "charge", Priority::Urgent },
+			{ "cqCancel", Priority::Urgent },
+			{ "cqReplaceOnNext", Priority::Urgent }
+		});
+
+		const Priority* priority = table.find(cmd);
+		return priority ? *priority : Priority::Bulk;
+	}
+
+	/**
+	 * @brief Classify a received binary protocol frame. Command frames take the priority of their command; memory opcodes are bulk.
+	 * @param The whole frame, header included.
+	 * @return The priority.
+	 */
+	Priority Handler::getFramePriority(const std::string& frame) {
+		Protocol::FrameHeader header;
+		std::memcpy(&header, frame.data(), sizeof(header));
+		if (header.opcode != Protocol::Opcode::Command) {
+			return Priority::Bulk;
+		}
+
+		return getPriority(Utils::firstToken(std::string_view(frame).substr(sizeof(header))));
+	}
+
+	/**
+	 * @brief Pick the receive queue for a text line. Only a tagged line may jump ahead; untagged lines all stay bulk, so they keep the order they were sent in.
+	 * @param The received line, request tag included.
+	 * @return The priority.
+	 */
+	Priority Handler::getReceivePriority(std::string_view line) {
+		if (!Utils::firstToken(line).starts_with('#')) {
+			return Priority::Bulk;
+		}
+
+		return getPriority(Utils::commandName(line));
+	}
+
+	/**
+	 * @brief Pick the receive queue for a binary protocol frame. Only a frame with a request id may jump ahead, as for text lines.
+	 * @param The whole frame, header included.
+	 * @return The priority.
+	 */
+	Priority Handler::getReceiveFramePriority(const std::string& frame) {
+		Protocol::FrameHeader header;
+		std::memcpy(&header, frame.data(), sizeof(header));
+		return header.requestId == 0 ? Priority::Bulk : getFramePriority(frame);
+	}
+#pragma endregion Command registration.
 #pragma region Vision
 	/**
 	 * @brief Handle the "peek" command.
 	 * @param [offset, size].
 	 * @param Output buffer for result.
 	 */
-	void Handler::peek_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::peek_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() != 2) {
 			return;
 		}
@@ -74,7 +348,7 @@ namespace CommandHandler {
 	 * @param [offset1, size1, offset2, size2, ...].
 	 * @param Output buffer for result.
 	 */
-	void Handler::peekMulti_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::peekMulti_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() < 2) {
 			return;
 		}
@@ -95,7 +369,7 @@ namespace CommandHandler {
 	 * @param [offset, size].
 	 * @param Output buffer for result.
 	 */
-	void Handler::peekAbsolute_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::peekAbsolute_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() != 2) {
 			return;
 		}
@@ -110,7 +384,7 @@ namespace CommandHandler {
 	 * @param [offset1, size1, offset2, size2, ...].
 	 * @param Output buffer for result.
 	 */
-	void Handler::peekAbsoluteMulti_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::peekAbsoluteMulti_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() < 2) {
 			return;
 		}
@@ -131,7 +405,7 @@ namespace CommandHandler {
 	 * @param [offset, size].
 	 * @param Output buffer for result.
 	 */
-	void Handler::peekMain_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::peekMain_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() != 2) {
 			return;
 		}
@@ -146,7 +420,7 @@ namespace CommandHandler {
 	 * @param [offset1, size1, offset2, size2, ...].
 	 * @param Output buffer for result.
 	 */
-	void Handler::peekMainMulti_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::peekMainMulti_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() < 2) {
 			return;
 		}
@@ -162,17 +436,82 @@ namespace CommandHandler {
 		peekMulti(offsets, sizes, buffer);
 	}
 
+	/**
+	 * @brief Handle the "peekDelta" command.
+	 * @param [offset, size, lastSeq (optional)].
+	 * @param Output buffer for result.
+	 */
+	void Handler::peekDelta_cmd(Args params, std::vector<char>& buffer) {
+		if (params.size() < 2 || params.size() > 3) {
+			return;
+		}
+
+		u64 offset = Utils::parseStringToInt(params[0]);
+		u64 size = Utils::parseStringToInt(params[1]);
+		u32 lastSeq = params.size() == 3 ? (u32)Utils::parseStringToInt(params[2]) : 0;
+		peekDelta(m_metaData.heap_base + offset, size, lastSeq, buffer);
+	}
+
+	/**
+	 * @brief Handle the "peekDeltaAbsolute" command.
+	 * @param [offset, size, lastSeq (optional)].
+	 * @param Output buffer for result.
+	 */
+	void Handler::peekDeltaAbsolute_cmd(Args params, std::vector<char>& buffer) {
+		if (params.size() < 2 || params.size() > 3) {
+			return;
+		}
+
+		u64 offset = Utils::parseStringToInt(params[0]);
+		u64 size = Utils::parseStringToInt(params[1]);
+		u32 lastSeq = params.size() == 3 ? (u32)Utils::parseStringToInt(params[2]) : 0;
+		peekDelta(offset, size, lastSeq, buffer);
+	}
+
+	/**
+	 * @brief Handle the "peekDeltaMain" command.
+	 * @param [offset, size, lastSeq (optional)].
+	 * @param Output buffer for result.
+	 */
+	void Handler::peekDeltaMain_cmd(Args params, std::vector<char>& buffer) {
+		if (params.size() < 2 || params.size() > 3) {
+			return;
+		}
+
+		u64 offset = Utils::parseStringToInt(params[0]);
+		u64 size = Utils::parseStringToInt(params[1]);
+		u32 lastSeq = params.size() == 3 ? (u32)Utils::parseStringToInt(params[2]) : 0;
+		peekDelta(m_metaData.main_nso_base + offset, size, lastSeq, buffer);
+	}
+
+	/**
+	 * @brief Handle the "peekDeltaClear" command.
+	 */
+	void Handler::peekDeltaClear_cmd() {
+		clearDeltaSnapshots();
+	}
+
 	/**
 	 * @brief Handle the "poke" command.
 	 * @param [offset, data].
 	 */
-	void Handler::poke_cmd(const std::vector<std::string>& params) {
+	void Handler::poke_cmd(Args params) {
 		if (params.size() != 2) {
 			return;
 		}
 
-		u64 offset = Utils::parseStringToInt(params[0]);
-		std::vector<char> buffer = Utils::parseStringToByteBuffer(params[1]);
+		u64 offset = 0;
+		if (!Utils::parseInt(params[0], offset)) {
+			Logger::instance().log("poke_cmd() invalid offset (" + std::string(params[0]) + ").");
+			return;
+		}
+
+		std::vector<char> buffer;
+		if (!Utils::parseByteBuffer(params[1], buffer)) {
+			Logger::instance().log("poke_cmd() invalid data (" + std::string(params[1]) + ").");
+			return;
+		}
+
 		poke(m_metaData.heap_base + offset, buffer.size(), buffer);
 	}
 
@@ -180,13 +519,23 @@ namespace CommandHandler {
 	 * @brief Handle the "pokeAbsolute" command.
 	 * @param [offset, data].
 	 */
-	void Handler::pokeAbsolute_cmd(const std::vector<std::string>& params) {
+	void Handler::pokeAbsolute_cmd(Args params) {
 		if (params.size() != 2) {
 			return;
 		}
 
-		u64 offset = Utils::parseStringToInt(params[0]);
-		std::vector<char> buffer = Utils::parseStringToByteBuffer(params[1]);
+		u64 offset = 0;
+		if (!Utils::parseInt(params[0], offset)) {
+			Logger::instance().log("pokeAbsolute_cmd() invalid offset (" + std::string(params[0]) + ").");
+			return;
+		}
+
+		std::vector<char> buffer;
+		if (!Utils::parseByteBuffer(params[1], buffer)) {
+			Logger::instance().log("pokeAbsolute_cmd() invalid data (" + std::string(params[1]) + ").");
+			return;
+		}
+
 		poke(offset, buffer.size(), buffer);
 	}
 
@@ -194,13 +543,23 @@ namespace CommandHandler {
 	 * @brief Handle the "pokeMain" command.
 	 * @param [offset, data].
 	 */
-	void Handler::pokeMain_cmd(const std::vector<std::string>& params) {
+	void Handler::pokeMain_cmd(Args params) {
 		if (params.size() != 2) {
 			return;
 		}
 
-		u64 offset = Utils::parseStringToInt(params[0]);
-		std::vector<char> buffer = Utils::parseStringToByteBuffer(params[1]);
+		u64 offset = 0;
+		if (!Utils::parseInt(params[0], offset)) {
+			Logger::instance().log("pokeMain_cmd() invalid offset (" + std::string(params[0]) + ").");
+			return;
+		}
+
+		std::vector<char> buffer;
+		if (!Utils::parseByteBuffer(params[1], buffer)) {
+			Logger::instance().log("pokeMain_cmd() invalid data (" + std::string(params[1]) + ").");
+			return;
+		}
+
 		poke(m_metaData.main_nso_base + offset, buffer.size(), buffer);
 	}
 
@@ -209,17 +568,17 @@ namespace CommandHandler {
 	 * @param [mainJump, jump1, jump2, ..., finalJump].
 	 * @param Output buffer for result.
 	 */
-	void Handler::pointerAll_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::pointerAll_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() < 2) {
 			return;
 		}
 
-		std::vector<std::string> mod = params;
+		Args mod = params;
 		s64 finalJump = Utils::parseStringToSignedLong(mod.back());
-		mod.pop_back();
+		mod = mod.first(mod.size() - 1);
 
 		s64 mainJump = Utils::parseStringToSignedLong(mod.front());
-		mod.erase(mod.begin());
+		mod = mod.subspan(1);
 
 		int count = mod.size();
 		std::vector<s64> jumps(count);
@@ -247,17 +606,17 @@ namespace CommandHandler {
 	 * @param [mainJump, jump1, jump2, ..., finalJump].
 	 * @param Output buffer for result.
 	 */
-	void Handler::pointerRelative_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::pointerRelative_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() < 2) {
 			return;
 		}
 
-		std::vector<std::string> mod = params;
+		Args mod = params;
 		s64 finalJump = Utils::parseStringToSignedLong(mod.back());
-		mod.pop_back();
+		mod = mod.first(mod.size() - 1);
 
 		s64 mainJump = Utils::parseStringToSignedLong(mod.front());
-		mod.erase(mod.begin());
+		mod = mod.subspan(1);
 
 		int count = mod.size();
 		std::vector<s64> jumps(count);
@@ -286,20 +645,20 @@ namespace CommandHandler {
 	 * @param [size, mainJump, jump1, ..., finalJump].
 	 * @param Output buffer for result.
 	 */
-	void Handler::pointerPeek_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::pointerPeek_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() < 3) {
 			return;
 		}
 
-		std::vector<std::string> mod = params;
+		Args mod = params;
 		s64 finalJump = Utils::parseStringToSignedLong(mod.back());
-		mod.pop_back();
+		mod = mod.first(mod.size() - 1);
 
 		u64 size = Utils::parseStringToSignedLong(mod.front());
-		mod.erase(mod.begin());
+		mod = mod.subspan(1);
 
 		s64 mainJump = Utils::parseStringToSignedLong(mod.front());
-		mod.erase(mod.begin());
+		mod = mod.subspan(1);
 
 		int count = mod.size();
 		std::vector<s64> jumps(count);
@@ -324,29 +683,24 @@ namespace CommandHandler {
 	 * @param Multiple pointer expressions separated by "*".
 	 * @param Output buffer for result.
 	 */
-	void Handler::pointerPeekMulti_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::pointerPeekMulti_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() < 3) {
 			return;
 		}
 
 		std::vector<u64> offsets;
 		std::vector<u64> sizes;
-		std::vector<std::vector<std::string>> groups;
-		std::vector<std::string> currentGroup;
-
-		for (const auto& param : params) {
-			if (param == "*") {
-				if (!currentGroup.empty()) {
-					groups.push_back(currentGroup);
-					currentGroup.clear();
+		std::vector<Args> groups;
+		size_t groupStart = 0;
+
+		for (size_t i = 0; i <= params.size(); ++i) {
+			if (i == params.size() || params[i] == "*") {
+				if (i > groupStart) {
+					groups.push_back(params.subspan(groupStart, i - groupStart));
 				}
-			} else {
-				currentGroup.push_back(param);
-			}
-		}
 
-		if (!currentGroup.empty()) {
-			groups.push_back(currentGroup);
+				groupStart = i + 1;
+			}
 		}
 
 		for (const auto& group : groups) {
@@ -354,15 +708,15 @@ namespace CommandHandler {
 				continue;
 			}
 
-			std::vector<std::string> mod = group;
+			Args mod = group;
 			s64 finalJump = Utils::parseStringToSignedLong(mod.back());
-			mod.pop_back();
+			mod = mod.first(mod.size() - 1);
 
 			s64 size = Utils::parseStringToSignedLong(mod.front());
-			mod.erase(mod.begin());
+			mod = mod.subspan(1);
 
 			s64 mainJump = Utils::parseStringToSignedLong(mod.front());
-			mod.erase(mod.begin());
+			mod = mod.subspan(1);
 
 			int count = mod.size();
 			std::vector<s64> jumps(count);
@@ -391,25 +745,43 @@ namespace CommandHandler {
 	 * @brief Handle the "pointerPoke" command.
 	 * @param Command parameters: [data, mainJump, jump1, ..., finalJump].
 	 */
-	void Handler::pointerPoke_cmd(const std::vector<std::string>& params) {
+	void Handler::pointerPoke_cmd(Args params) {
 		if (params.size() < 3) {
 			return;
 		}
 
-		std::vector<std::string> mod = params;
-		s64 finalJump = Utils::parseStringToSignedLong(mod.back());
-		mod.pop_back();
+		Args mod = params;
+		s64 finalJump = 0;
+		if (!Utils::parseSignedInt(mod.back(), finalJump)) {
+			Logger::instance().log("pointerPoke_cmd() invalid final jump (" + std::string(mod.back()) + ").");
+			return;
+		}
 
-		std::vector<char> data = Utils::parseStringToByteBuffer(mod.front());
-		mod.erase(mod.begin());
+		mod = mod.first(mod.size() - 1);
 
-		s64 mainJump = Utils::parseStringToSignedLong(mod.front());
-		mod.erase(mod.begin());
+		std::vector<char> data;
+		if (!Utils::parseByteBuffer(mod.front(), data)) {
+			Logger::instance().log("pointerPoke_cmd() invalid data (" + std::string(mod.front()) + ").");
+			return;
+		}
+
+		mod = mod.subspan(1);
+
+		s64 mainJump = 0;
+		if (!Utils::parseSignedInt(mod.front(), mainJump)) {
+			Logger::instance().log("pointerPoke_cmd() invalid main jump (" + std::string(mod.front()) + ").");
+			return;
+		}
+
+		mod = mod.subspan(1);
 
 		int count = mod.size();
 		std::vector<s64> jumps(count);
 		for (int i = 0; i < count; i++) {
-			jumps[i] = Utils::parseStringToSignedLong(mod[i]);
+			if (!Utils::parseSignedInt(mod[i], jumps[i])) {
+				Logger::instance().log("pointerPoke_cmd() invalid jump (" + std::string(mod[i]) + ").");
+				return;
+			}
 		}
 
 		std::vector<char> buffer;
@@ -422,13 +794,167 @@ namespace CommandHandler {
 		val += finalJump;
 		poke(val, data.size(), data);
 	}
+
+	/**
+	 * @brief Handle the "regionMap" command.
+	 * @param Output buffer for result, one "address:size:type:permission" entry in hex per mapped region.
+	 */
+	void Handler::regionMap_cmd(std::vector<char>& buffer) {
+		const auto& regions = getRegionMap(true);
+		std::string res;
+		res.reserve(regions.size() * 40);
+		char entry[64];
+		for (const auto& region : regions) {
+			int len = std::snprintf(entry, sizeof(entry), "%s%lX:%lX:%X:%X", res.empty() ? "" : " ", region.addr, region.size, region.type, region.perm);
+			res.append(entry, len);
+		}
+
+		res += "\r\n";
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+
+	/**
+	 * @brief Set the stream used to send large responses in chunks. Pass an empty stream to always return whole responses.
+	 * @param The response stream.
+	 */
+	void Handler::setResponseStream(ResponseStream stream) {
+		m_responseStream = std::move(stream);
+	}
+
+	/**
+	 * @brief Give the handler the connection's receive queue so "stats queues" can report it.
+	 * @param The queue. Must outlive the handler.
+	 */
+	void Handler::setCommandQueue(const PriorityQueue::CommandQueue* queue) {
+		m_commandQueue = queue;
+	}
+
+	/**
+	 * @brief Choose whose settings frame unsolicited messages such as watch events.
+	 * @param The settings of the client receiving them, or nullptr for the handler's defaults.
+	 */
+	void Handler::setEventClient(std::shared_ptr<ModuleBase::ClientSettings> settings) {
+		m_eventSettings.store(std::move(settings));
+	}
+
+	/**
+	 * @brief Give "stats sends" the connection's sender counters.
+	 * @param The counters, or nullptr if the connection doesn't keep them.
+	 */
+	void Handler::setSendStats(const SendStats* stats) {
+		m_sendStats = stats;
+	}
 #pragma endregion Various memory read/write commands.
+#pragma region Scan
+	/**
+	 * @brief Handle the "scanStart" command.
+	 * @param [type, value, (startAddress), (endAddress)].
+	 * @param Output buffer for result.
+	 */
+	void Handler::scanStart_cmd(Args params, std::vector<char>& buffer) {
+		if (params.size() != 2 && params.size() != 4) {
+			return;
+		}
+
+		ScanType type;
+		if (!parseScanType(params[0], type)) {
+			Logger::instance().log("scanStart_cmd() unknown type (" + std::string(params[0]) + ").");
+			return;
+		}
+
+		u64 start = params.size() == 4 ? Utils::parseStringToInt(params[2]) : 0;
+		u64 end = params.size() == 4 ? Utils::parseStringToInt(params[3]) : UINT64_MAX;
+		scanStart(type, params[1], start, end, buffer);
+	}
+
+	/**
+	 * @brief Handle the "scanNext" command.
+	 * @param [mode, (value)].
+	 * @param Output buffer for result.
+	 */
+	void Handler::scanNext_cmd(Args params, std::vector<char>& buffer) {
+		if (params.empty() || params.size() > 2) {
+			return;
+		}
+
+		ScanMode mode;
+		if (!parseScanMode(params[0], mode)) {
+			Logger::instance().log("scanNext_cmd() unknown mode (" + std::string(params[0]) + ").");
+			return;
+		}
+
+		scanNext(mode, params.size() == 2 ? params[1] : std::string(), buffer);
+	}
+
+	/**
+	 * @brief Handle the "scanResults" command.
+	 * @param [(max)].
+	 * @param Output buffer for result.
+	 */
+	void Handler::scanResults_cmd(Args params, std::vector<char>& buffer) {
+		u64 max = params.empty() ? 16 : Utils::parseStringToInt(params[0]);
+		scanResults(max, buffer);
+	}
+
+	/**
+	 * @brief Handle the "scanReset" command.
+	 */
+	void Handler::scanReset_cmd() {
+		scanReset();
+	}
+#pragma endregion Incremental value scan commands.
+#pragma region Watch
+	/**
+	 * @brief Handle the "watchAdd" command.
+	 * @param [id, size, intervalMs, heap|main|absolute, offset] or [id, size, intervalMs, pointer, mainJump, jump1, ..., finalJump].
+	 */
+	void Handler::watchAdd_cmd(Args params) {
+		if (params.size() < 5) {
+			return;
+		}
+
+		WatchSpec spec;
+		if (!parseWatchBase(params[3], spec.base)) {
+			return;
+		}
+
+		spec.size = Utils::parseStringToInt(params[1]);
+		spec.intervalTicks = armNsToTicks(std::max<u64>(Utils::parseStringToInt(params[2]), 1) * 1000000ULL);
+		spec.offset = Utils::parseStringToSignedLong(params.back());
+		if (spec.base == WatchBase::Pointer) {
+			if (params.size() < 6) {
+				return;
+			}
+
+			spec.mainJump = Utils::parseStringToSignedLong(params[4]);
+			for (size_t i = 5; i < params.size() - 1; ++i) {
+				spec.jumps.push_back(Utils::parseStringToSignedLong(params[i]));
+			}
+		} else if (params.size() != 5) {
+			return;
+		}
+
+		watchAdd(std::string(params.front()), spec);
+	}
+
+	/**
+	 * @brief Handle the "watchRemove" command.
+	 * @param [id].
+	 */
+	void Handler::watchRemove_cmd(Args params) {
+		if (params.size() != 1) {
+			return;
+		}
+
+		watchRemove(std::string(params.front()));
+	}
+#pragma endregion Memory watch subscription commands.
 #pragma region Controller
 	/**
 	 * @brief Handle the "click" command.
 	 * @param Command parameters: [buttonName].
 	 */
-	void Handler::click_cmd(const std::vector<std::string>& params) {
+	void Handler::click_cmd(Args params) {
 		if (params.size() != 1) {
 			return;
 		}
@@ -440,7 +966,7 @@ namespace CommandHandler {
 	 * @brief Handle the "press" command.
 	 * @param Command parameters: [buttonName].
 	 */
-	void Handler::press_cmd(const std::vector<std::string>& params) {
+	void Handler::press_cmd(Args params) {
 		if (params.size() != 1) {
 			return;
 		}
@@ -453,7 +979,7 @@ namespace CommandHandler {
 	 * @brief Handle the "release" command.
 	 * @param Command parameters: [buttonName].
 	 */
-	void Handler::release_cmd(const std::vector<std::string>& params) {
+	void Handler::release_cmd(Args params) {
 		if (params.size() != 1) {
 			return;
 		}
@@ -466,7 +992,7 @@ namespace CommandHandler {
 	 * @brief Handle the "setStick" command.
 	 * @param Command parameters: [stickName, dx, dy].
 	 */
-	void Handler::setStick_cmd(const std::vector<std::string>& params) {
+	void Handler::setStick_cmd(Args params) {
 		if (params.size() != 3) {
 			return;
 		}
@@ -476,7 +1002,7 @@ namespace CommandHandler {
 			return;
 		}
 
-		int dxVal = std::stoull(params[1], NULL, 0);
+		int dxVal = (int)Utils::parseStringToSignedLong(params[1]);
 		if (dxVal > JOYSTICK_MAX) {
 			dxVal = JOYSTICK_MAX;
 		} else if (dxVal < JOYSTICK_MIN) {
@@ -484,7 +1010,7 @@ namespace CommandHandler {
 		}
 
 
-		int dyVal = std::stoull(params[2], NULL, 0);
+		int dyVal = (int)Utils::parseStringToSignedLong(params[2]);
 		if (dyVal > JOYSTICK_MAX) {
 			dyVal = JOYSTICK_MAX;
 		} else if (dyVal < JOYSTICK_MIN) {
@@ -498,7 +1024,7 @@ namespace CommandHandler {
 	 * @brief Handle the "touch" command.
 	 * @param Command parameters: [x1, y1, x2, y2, ...].
 	 */
-	void Handler::touch_cmd(const std::vector<std::string>& params) {
+	void Handler::touch_cmd(Args params) {
 		if (params.size() < 2) {
 			return;
 		}
@@ -519,7 +1045,7 @@ namespace CommandHandler {
 	 * @brief Handle the "touchHold" command.
 	 * @param Command parameters: [x, y, timeMs].
 	 */
-	void Handler::touchHold_cmd(const std::vector<std::string>& params) {
+	void Handler::touchHold_cmd(Args params) {
 		if (params.size() < 3) {
 			return;
 		}
@@ -536,7 +1062,7 @@ namespace CommandHandler {
 	 * @brief Handle the "touchDraw" command.
 	 * @param Command parameters: [x1, y1, x2, y2, ...].
 	 */
-	void Handler::touchDraw_cmd(const std::vector<std::string>& params) {
+	void Handler::touchDraw_cmd(Args params) {
 		if (params.size() < 2) {
 			return;
 		}
@@ -557,7 +1083,7 @@ namespace CommandHandler {
 	 * @brief Handle the "key" command.
 	 * @param [key1, key2, ...].
 	 */
-	void Handler::key_cmd(const std::vector<std::string>& params) {
+	void Handler::key_cmd(Args params) {
 		if (params.size() < 1) {
 			return;
 		}
@@ -579,7 +1105,7 @@ namespace CommandHandler {
 	 * @brief Handle the "keyMod" command.
 	 * @param [key1, mod1, key2, mod2, ...].
 	 */
-	void Handler::keyMod_cmd(const std::vector<std::string>& params) {
+	void Handler::keyMod_cmd(Args params) {
 		if (params.size() < 2) {
 			return;
 		}
@@ -602,7 +1128,7 @@ namespace CommandHandler {
 	 * @brief Handle the "keyMulti" command.
 	 * @param [key1, key2, ...].
 	 */
-	void Handler::keyMulti_cmd(const std::vector<std::string>& params) {
+	void Handler::keyMulti_cmd(Args params) {
 		if (params.size() < 1) {
 			return;
 		}
@@ -640,14 +1166,14 @@ namespace CommandHandler {
 	 * @param [subcommand] (name, author, rating, version, icon).
 	 * @param Output buffer for result.
 	 */
-	void Handler::game_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::game_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() != 1) {
 			return;
 		}
 
-		auto it = BaseCommands::m_game.find(params.front());
-		if (it != BaseCommands::m_game.end()) {
-			it->second(buffer);
+		const GameFunc* function = findGame(params.front());
+		if (function) {
+			(*function)(*this, buffer);
 		} else {
 			Logger::instance().log("game_cmd() subcommand not found.");
 		}
@@ -658,7 +1184,6 @@ namespace CommandHandler {
 	 * @param Output buffer for result.
 	 */
 	void Handler::getTitleID_cmd(std::vector<char>& buffer) {
-		initMetaData();
 		buffer.resize(sizeof(m_metaData.titleID));
 		std::copy(reinterpret_cast<const char*>(&m_metaData.titleID),
 			reinterpret_cast<const char*>(&m_metaData.titleID) + sizeof(m_metaData.titleID),
@@ -674,7 +1199,6 @@ namespace CommandHandler {
 	 * @param Output buffer for result.
 	 */
 	void Handler::getBuildID_cmd(std::vector<char>& buffer) {
-		initMetaData();
 		buffer.resize(sizeof(m_metaData.buildID));
 		std::copy(reinterpret_cast<const char*>(&m_metaData.buildID),
 			reinterpret_cast<const char*>(&m_metaData.buildID) + sizeof(m_metaData.buildID),
@@ -690,7 +1214,6 @@ namespace CommandHandler {
 	 * @param Output buffer for result.
 	 */
 	void Handler::getTitleVersion_cmd(std::vector<char>& buffer) {
-		initMetaData();
 		buffer.resize(sizeof(m_metaData.titleVersion));
 		std::copy(reinterpret_cast<const char*>(&m_metaData.titleVersion),
 			reinterpret_cast<const char*>(&m_metaData.titleVersion) + sizeof(m_metaData.titleVersion),
@@ -728,7 +1251,7 @@ namespace CommandHandler {
 	 * @param [programID].
 	 * @param Output buffer for result.
 	 */
-	void Handler::isProgramRunning_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::isProgramRunning_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() != 1) {
 			return;
 		}
@@ -789,7 +1312,6 @@ namespace CommandHandler {
 	 * @param Output buffer for result.
 	 */
 	void Handler::getMainNsoBase_cmd(std::vector<char>& buffer) {
-		initMetaData();
 		buffer.resize(sizeof(m_metaData.main_nso_base));
 		std::copy(reinterpret_cast<const char*>(&m_metaData.main_nso_base),
 			reinterpret_cast<const char*>(&m_metaData.main_nso_base) + sizeof(m_metaData.main_nso_base),
@@ -805,7 +1327,6 @@ namespace CommandHandler {
 	 * @param Output buffer for result.
 	 */
 	void Handler::getHeapBase_cmd(std::vector<char>& buffer) {
-		initMetaData();
 		buffer.resize(sizeof(m_metaData.heap_base));
 		std::copy(reinterpret_cast<const char*>(&m_metaData.heap_base),
 			reinterpret_cast<const char*>(&m_metaData.heap_base) + sizeof(m_metaData.heap_base),
@@ -859,7 +1380,7 @@ namespace CommandHandler {
 	 * @brief Handle the "configure" command.
 	 * @param [name, value].
 	 */
-	void Handler::configure_cmd(const std::vector<std::string>& params) {
+	void Handler::configure_cmd(Args params) {
 		if (params.size() != 2) {
 			return;
 		}
@@ -869,9 +1390,9 @@ namespace CommandHandler {
 			return;
 		}
 
-		auto it = BaseCommands::m_configure.find(params.front());
-		if (it != BaseCommands::m_configure.end()) {
-			it->second(params);
+		const ConfigureFunc* function = findConfigure(params.front());
+		if (function) {
+			(*function)(*this, params);
 		} else {
 			Logger::instance().log("configure_cmd() subfunction not found.");
 		}
@@ -890,19 +1411,39 @@ namespace CommandHandler {
 	 * @param [value].
 	 * @param Output buffer for result.
 	 */
-	void Handler::ping_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::ping_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() != 1) {
 			return;
 		}
 
-		std::string value;
-		try {
-			value = std::to_string(Utils::parseStringToInt(params[0]));
-		} catch (...) {
-			Logger::instance().log("ping_cmd() failed to parse value.");
-			value = std::to_string(0);
+		u64 parsed = 0;
+		if (!Utils::parseInt(params[0], parsed)) {
+			Logger::instance().log("ping_cmd() invalid value (" + std::string(params[0]) + ").");
 		}
 
+		std::string value = std::to_string(parsed);
+		buffer.insert(buffer.begin(), value.begin(), value.end());
+	}
+
+	/**
+	 * @brief Handle the "barrier" command. The connection runs it once every lane has drained, so its reply means all earlier commands finished.
+	 * @param Output buffer for result.
+	 */
+	void Handler::barrier_cmd(std::vector<char>& buffer) {
+		std::string value = "1";
+		buffer.insert(buffer.begin(), value.begin(), value.end());
+	}
+
+	/**
+	 * @brief Handle the "reloadConfig" command. Re-reads config.cfg; a transport change only applies after a restart.
+	 * @param Output buffer for result, "transport=<file> active=<running>".
+	 */
+	void Handler::reloadConfig_cmd(std::vector<char>& buffer) {
+		auto& settings = Config::Settings::instance();
+		auto snapshot = settings.reload();
+		std::string value = "transport=" + std::string(Config::Settings::transportName(snapshot->transport))
+			+ " active=" + std::string(Config::Settings::transportName(settings.transport()));
+
 		buffer.insert(buffer.begin(), value.begin(), value.end());
 	}
 #pragma endregion Miscellaneous commands that get/set parameters.
@@ -920,7 +1461,7 @@ namespace CommandHandler {
 	 * @param [time].
 	 * @param Output buffer for result.
 	 */
-	void Handler::setSwitchTime_cmd(const std::vector<std::string>& params, std::vector<char>& buffer) {
+	void Handler::setSwitchTime_cmd(Args params, std::vector<char>& buffer) {
 		if (params.size() != 1) {
 			return;
 		}
@@ -936,4 +1477,538 @@ namespace CommandHandler {
 		resetSwitchTime(buffer);
 	}
 #pragma endregion Time commands.
+#pragma region Session
+	/**
+	 * @brief Handle the "debugSessionBegin" command. Keeps the debug handle open across commands until the same client sends "debugSessionEnd" or disconnects.
+	 */
+	void Handler::debugSessionBegin_cmd() {
+		std::lock_guard<std::recursive_mutex> lock(m_debugMutex);
+		ModuleBase::ClientSettings& settings = clientSettings();
+		if (settings.debugSession || settings.closed) {
+			return;
+		}
+
+		beginDebugSession();
+		++m_clientDebugSessions;
+		settings.debugSession = true;
+	}
+
+	/**
+	 * @brief Handle the "debugSessionEnd" command.
+	 */
+	void Handler::debugSessionEnd_cmd() {
+		endClientDebugSession();
+	}
+
+	/**
+	 * @brief End the current client's debug session, if it has one.
+	 */
+	void Handler::endClientDebugSession() {
+		std::lock_guard<std::recursive_mutex> lock(m_debugMutex);
+		ModuleBase::ClientSettings& settings = clientSettings();
+		if (!settings.debugSession) {
+			return;
+		}
+
+		settings.debugSession = false;
+		--m_clientDebugSessions;
+		endDebugSession();
+	}
+
+	/**
+	 * @brief Reset per-client state when the client disconnects: end its debug session, drop its delta snapshots, scan and watches, and turn compression back off.
+	 */
+	void Handler::endClientSession() {
+		endClientDebugSession();
+		clearDeltaSnapshots();
+		scanReset();
+		watchClear();
+		clientSettings().compressionEnabled = false;
+		clientSettings().protocolVersion = Protocol::TextVersion;
+	}
+
+	/**
+	 * @brief End the current client's session for good when one of several clients disconnects. Its settings go away with it.
+	 */
+	void Handler::closeClientSession() {
+		std::lock_guard<std::recursive_mutex> lock(m_debugMutex);
+		endClientSession();
+		clientSettings().closed = true;
+	}
+#pragma endregion Client-defined debug session commands.
+#pragma region Batch
+	/**
+	 * @brief Whether a command may run inside an "exec" batch. Only memory reads and writes and cheap metadata getters are allowed,
+	 * since the game stays paused for the whole batch. Anything slow, anything with side effects beyond game memory, and anything
+	 * that changes the response format mid-batch (input, capture, scans, watches, configure, time and session commands) is refused.
+	 * @param The command name.
+	 * @return true if the command may be batched.
+	 */
+	bool Handler::isBatchable(std::string_view cmd) {
+		static constexpr auto table = Dispatch::makeTable<std::string_view, bool>({
+			{ "peek", true },
+			{ "peekMulti", true },
+			{ "peekAbsolute", true },
+			{ "peekAbsoluteMulti", true },
+			{ "peekMain", true },
+			{ "peekMainMulti", true },
+			{ "peekDelta", true },
+			{ "peekDeltaAbsolute", true },
+			{ "peekDeltaMain", true },
+			{ "poke", true },
+			{ "pokeAbsolute", true },
+			{ "pokeMain", true },
+			{ "pointerAll", true },
+			{ "pointerRelative", true },
+			{ "pointerPeek", true },
+			{ "pointerPeekMulti", true },
+			{ "pointerPoke", true },
+			{ "regionMap", true },
+
+			{ "getMainNsoBase", true },
+			{ "getHeapBase", true },
+			{ "getBuildID", true },
+			{ "getTitleVersion", true },
+			{ "getTitleID", true },
+			{ "getSystemLanguage", true },
+			{ "isProgramRunning", true },
+			{ "getVersion", true }
+		});
+
+		return table.find(cmd) != nullptr;
+	}
+
+	/**
+	 * @brief Handle the "exec" command: run several commands under the caller's single debug session and metadata snapshot.
+	 * The game stays paused by the debug handle for the whole batch, so every result reflects the same frame.
+	 * @param Sub-commands separated by ";" tokens, e.g. [getHeapBase, ;, peekMulti, 0x10, 4, ;, ...].
+	 * @param Output buffer for result: one line per sub-command with backwards compatibility over WiFi,
+	 * otherwise u32 count followed by u32 length and the bytes of each result.
+	 */
+	void Handler::exec_cmd(Args params, std::vector<char>& buffer) {
+		std::vector<Args> batch;
+		size_t start = 0;
+		for (size_t i = 0; i <= params.size(); ++i) {
+			if (i == params.size() || params[i] == ";") {
+				if (i > start) {
+					batch.push_back(params.subspan(start, i - start));
+				}
+
+				start = i + 1;
+			}
+		}
+
+		if (batch.empty() || batch.size() > ExecMaxCommands) {
+			Logger::instance().log("exec_cmd() expected 1 to " + std::to_string(ExecMaxCommands) + " commands, got " + std::to_string(batch.size()) + ".");
+			return;
+		}
+
+		// Resolve the whole batch up front so an unknown or disallowed command fails it before anything runs.
+		std::vector<const CmdFunc*> functions;
+		functions.reserve(batch.size());
+		for (Args command : batch) {
+			const CmdFunc* function = findCommand(command.front());
+			if (!function || !isBatchable(command.front())) {
+				Logger::instance().log("exec_cmd() command not allowed in a batch (" + std::string(command.front()) + ").");
+				return;
+			}
+
+			functions.push_back(function);
+		}
+
+		// Large peeks would otherwise stream straight to the client in the middle of the batch.
+		WholeReads wholeReads(*this, false);
+
+		bool text = g_enableBackwardsCompat && !Utils::isUSB();
+		if (!text) {
+			u32 count = (u32)batch.size();
+			buffer.insert(buffer.end(), reinterpret_cast<const char*>(&count), reinterpret_cast<const char*>(&count) + sizeof(count));
+		}
+
+		std::vector<char> result;
+		for (size_t i = 0; i < batch.size(); ++i) {
+			result.clear();
+			(*functions[i])(*this, batch[i].subspan(1), result);
+			if (text) {
+				while (!result.empty() && (result.back() == '\n' || result.back() == '\r')) {
+					result.pop_back();
+				}
+
+				if (i > 0) {
+					buffer.push_back('\n');
+				}
+			} else {
+				u32 length = (u32)result.size();
+				buffer.insert(buffer.end(), reinterpret_cast<const char*>(&length), reinterpret_cast<const char*>(&length) + sizeof(length));
+			}
+
+			buffer.insert(buffer.end(), result.begin(), result.end());
+		}
+	}
+#pragma endregion Multi-command batches.
+#pragma region Compression
+	/**
+	 * @brief Compress a finished response if compression is enabled and the response is at or above the threshold.
+	 * Compressed responses are sent as a "#lz4 {rawSize} {compressedSize}\r\n" header followed by one LZ4 block.
+	 * The block decompresses to the exact bytes that would otherwise have been sent. Responses that don't shrink are sent as-is.
+	 * @param[in,out] The response.
+	 */
+	void Handler::compressResponse(std::vector<char>& buffer) {
+		ClientSettings& settings = clientSettings();
+		if (!settings.compressionEnabled || settings.protocolVersion == Protocol::BinaryVersion || buffer.size() < settings.compressionThreshold || buffer.empty()) {
+			return;
+		}
+
+		auto& pool = BufferPool::Pool::instance();
+		std::vector<char> compressed = pool.acquire(Compression::Lz4::compressBound(buffer.size()) + 32);
+		Compression::Lz4::compress(buffer.data(), buffer.size(), compressed);
+		std::string header = "#lz4 " + std::to_string(buffer.size()) + " " + std::to_string(compressed.size()) + "\r\n";
+		if (header.size() + compressed.size() >= buffer.size()) {
+			pool.release(std::move(compressed));
+			return;
+		}
+
+		compressed.insert(compressed.begin(), header.begin(), header.end());
+		buffer.swap(compressed);
+		pool.release(std::move(compressed));
+	}
+#pragma endregion Negotiated response compression.
+#pragma region Stats
+	/**
+	 * @brief Handle the "stats" command.
+	 * @param [name].
+	 * @param Output buffer for result.
+	 */
+	void Handler::stats_cmd(Args params, std::vector<char>& buffer) {
+		if (params.size() != 1) {
+			return;
+		}
+
+		const StatsFunc* function = findStats(params.front());
+		if (function) {
+			(*function)(*this, buffer);
+		} else {
+			Logger::instance().log("stats_cmd() stats not found (" + std::string(params.front()) + ").");
+		}
+	}
+
+	/**
+	 * @brief Report metadata cache hits and misses.
+	 * @param Output buffer for result.
+	 */
+	void Handler::statsMetaCache(std::vector<char>& buffer) {
+		std::string res = "hits=" + std::to_string(m_metaCacheHits) + " misses=" + std::to_string(m_metaCacheMisses) + "\r\n";
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+
+	/**
+	 * @brief Report pointer chain cache hits and misses.
+	 * @param Output buffer for result.
+	 */
+	void Handler::statsPointerCache(std::vector<char>& buffer) {
+		std::string res = "hits=" + std::to_string(m_pointerCacheHits) + " misses=" + std::to_string(m_pointerCacheMisses) + "\r\n";
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+
+	/**
+	 * @brief Report the urgent and bulk receive queues: current depth, peak depth, commands queued and commands dropped because the queue was full.
+	 * @param Output buffer for result, one line per queue.
+	 */
+	void Handler::statsQueues(std::vector<char>& buffer) {
+		if (!m_commandQueue) {
+			return;
+		}
+
+		std::string res;
+		for (Priority priority : { Priority::Urgent, Priority::Bulk }) {
+			auto stats = m_commandQueue->getStats(priority);
+			res += std::string(priority == Priority::Urgent ? "urgent" : "bulk") + " depth=" + std::to_string(stats.depth) + " peakDepth=" + std::to_string(stats.peakDepth)
+				+ " pushed=" + std::to_string(stats.pushed) + " drops=" + std::to_string(stats.drops) + "\r\n";
+		}
+
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+
+	/**
+	 * @brief Report responses sent, send() calls, writes that coalesced several responses, bytes sent and send() calls per response.
+	 * @param Output buffer for result.
+	 */
+	void Handler::statsSends(std::vector<char>& buffer) {
+		if (!m_sendStats) {
+			return;
+		}
+
+		u64 responses = m_sendStats->responses;
+		u64 sends = m_sendStats->sends;
+		char res[160];
+		int len = std::snprintf(res, sizeof(res), "responses=%lu sends=%lu coalesced=%lu bytes=%lu sendsPerResponse=%.2f\r\n",
+			responses, sends, m_sendStats->coalesced.load(), m_sendStats->bytes.load(), responses == 0 ? 0.0 : (double)sends / responses);
+		buffer.insert(buffer.begin(), res, res + len);
+	}
+
+	/**
+	 * @brief Report response buffer pool hits, misses, buffers dropped because the pool was full, and bytes held now and at peak.
+	 * @param Output buffer for result.
+	 */
+	void Handler::statsBufferPool(std::vector<char>& buffer) {
+		auto stats = BufferPool::Pool::instance().getStats();
+		std::string res = "hits=" + std::to_string(stats.hits) + " misses=" + std::to_string(stats.misses) + " drops=" + std::to_string(stats.drops)
+			+ " pooledBytes=" + std::to_string(stats.pooledBytes) + " peakBytes=" + std::to_string(stats.peakBytes) + "\r\n";
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+#pragma endregion Runtime counters.
+#pragma region Protocol
+	/**
+	 * @brief Handle the "protocol" command. Switches this connection to the binary protocol (2) or back to text (1).
+	 * The acknowledgement is sent as text; the client must wait for it before sending frames.
+	 * @param [version].
+	 * @param Output buffer for result.
+	 */
+	void Handler::protocol_cmd(Args params, std::vector<char>& buffer) {
+		if (params.size() != 1) {
+			return;
+		}
+
+		u32 version = (u32)Utils::parseStringToInt(params.front());
+		if (version != Protocol::TextVersion && version != Protocol::BinaryVersion) {
+			Logger::instance().log("protocol_cmd() unsupported version: " + std::to_string(version));
+			return;
+		}
+
+		clientSettings().protocolVersion = version;
+		std::string res = std::to_string(version) + "\r\n";
+		buffer.insert(buffer.begin(), res.begin(), res.end());
+	}
+
+	/**
+	 * @brief Returns whether this connection uses the binary protocol.
+	 * @return True if binary frames are expected, false for text lines.
+	 */
+	bool Handler::isBinaryProtocol() {
+		return clientSettings().protocolVersion == Protocol::BinaryVersion;
+	}
+
+	/**
+	 * @brief Handle one binary protocol frame.
+	 * @param The complete frame, header included.
+	 * @param false when running on a lane worker, where streamed chunks could interleave with other lanes' frames.
+	 * @return The response frame, or an empty buffer if the response was already streamed.
+	 */
+	std::vector<char> Handler::HandleFrame(const std::string& frame, bool allowStream) {
+		Protocol::FrameHeader header;
+		std::memcpy(&header, frame.data(), sizeof(header));
+		Protocol::ArgReader args(frame.data() + sizeof(header), frame.size() - sizeof(header));
+		Logger::instance().log("HandleFrame opcode: " + std::to_string(header.opcode) + ", requestId: " + std::to_string(header.requestId));
+
+		// The response to a protocol switch is still a frame, so the client can match it by request id.
+		if (header.opcode == Protocol::Opcode::SetProtocol) {
+			u32 version = 0;
+			bool ok = args.read(version) && (version == Protocol::TextVersion || version == Protocol::BinaryVersion);
+			if (ok) {
+				clientSettings().protocolVersion = version;
+			}
+
+			return Protocol::Frame::make(header.opcode, ok ? Protocol::Flags::None : Protocol::Flags::Error, header.requestId, nullptr, 0);
+		}
+
+		// Input and capture frames run beside the memory lane, so they must not touch the shared session state.
+		std::optional<DebugSession> session;
+		std::optional<WholeReads> wholeReads;
+		if (needsDebugSession(getFrameLane(frame)) && getFramePriority(frame) == Priority::Bulk) {
+			session.emplace(static_cast<BaseCommands&>(*this));
+			updateApplicationMetaData();
+			m_frameStreamed = false;
+			if (!allowStream) {
+				wholeReads.emplace(static_cast<Vision&>(*this), true);
+			}
+		}
+
+		std::vector<char> payload = BufferPool::Pool::instance().acquire();
+		bool ok = false;
+		const FrameFunc* function = findFrame(header.opcode);
+		if (function) {
+			ok = (*function)(*this, header, args, payload);
+		} else {
+			Logger::instance().log("HandleFrame() opcode not found (" + std::to_string(header.opcode) + ").");
+		}
+
+		if (session && m_frameStreamed) {
+			return {};
+		}
+
+		if (!ok) {
+			payload.clear();
+		}
+
+		std::vector<char> response = BufferPool::Pool::instance().acquire(sizeof(header) + payload.size());
+		Protocol::Frame::writeHeader(response, header.opcode, ok ? Protocol::Flags::None : Protocol::Flags::Error, header.requestId, (u32)payload.size());
+		response.insert(response.end(), payload.begin(), payload.end());
+		BufferPool::Pool::instance().release(std::move(payload));
+		return response;
+	}
+
+	/**
+	 * @brief Refresh the cached metadata for the running application, or invalidate it if none is running.
+	 */
+	void Handler::updateApplicationMetaData() {
+		u64 pid = 0;
+		Result rc = pmdmntGetApplicationProcessId(&pid);
+		if (R_SUCCEEDED(rc)) {
+			updateMetaData(pid);
+		} else {
+			invalidateMetaData();
+		}
+	}
+
+	/**
+	 * @brief Resolve a frame's base and offset to an absolute address.
+	 * @param The base: heap, main or absolute.
+	 * @param The offset from the base.
+	 * @param[out] The absolute address.
+	 * @return false if the base is unknown.
+	 */
+	bool Handler::resolveFrameAddress(u32 base, u64 offset, u64& address) {
+		switch (base) {
+			case Protocol::Base::Heap: address = m_metaData.heap_base + offset; return true;
+			case Protocol::Base::Main: address = m_metaData.main_nso_base + offset; return true;
+			case Protocol::Base::Absolute: address = offset; return true;
+			default: return false;
+		}
+	}
+
+	/**
+	 * @brief Run a text command inside a frame. The response is exactly what the text command returns.
+	 * @param The frame header.
+	 * @param Frame arguments: the command line.
+	 * @param[out] The command's response.
+	 * @return false if the command is unknown.
+	 */
+	bool Handler::frameCommand(const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload) {
+		bool found = false;
+		std::vector<std::string_view> tokens;
+		Utils::parseArgs(std::string_view(args.current(), args.remaining()), tokens, [&](std::string_view cmd, Args params) {
+			const CmdFunc* function = findCommand(cmd);
+			if (function && cmd != "protocol") {
+				(*function)(*this, params, payload);
+				found = true;
+			}
+		});
+
+		return found;
+	}
+
+	/**
+	 * @brief Read raw bytes, at most Protocol::MaxFrameLength. Reads larger than MAX_LINE_LENGTH are streamed behind the response header.
+	 * @param The frame header.
+	 * @param Frame arguments: u32 base, u32 size, u64 offset.
+	 * @param[out] The bytes read.
+	 * @return false if the arguments are invalid or the read failed.
+	 */
+	bool Handler::framePeek(const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload) {
+		u32 base = 0, size = 0;
+		u64 offset = 0, address = 0;
+		if (!args.read(base) || !args.read(size) || !args.read(offset) || !resolveFrameAddress(base, offset, address)) {
+			return false;
+		}
+
+		if (size == 0 || size > Protocol::MaxFrameLength) {
+			return false;
+		}
+
+		if (size > MAX_LINE_LENGTH && m_responseStream) {
+			// Once the header is out the frame can only be filled, not failed, so the range is checked first.
+			if (!checkRange(address, size, true)) {
+				Logger::instance().log("framePeek() range is not mapped readable. Offset=" + std::to_string(address) + ", Size=" + std::to_string(size));
+				return false;
+			}
+
+			std::vector<char> response;
+			Protocol::Frame::writeHeader(response, header.opcode, Protocol::Flags::None, header.requestId, size);
+			peekStreamed(address, size, payload, std::move(response));
+			m_frameStreamed = true;
+			return true;
+		}
+
+		return R_SUCCEEDED(readRange(address, size, payload));
+	}
+
+	/**
+	 * @brief Read several ranges in one coalesced pass.
+	 * @param The frame header.
+	 * @param Frame arguments: u32 base, u32 count, then count * (u64 offset, u64 size).
+	 * @param[out] The bytes read, in request order.
+	 * @return false if the arguments are invalid or a read failed.
+	 */
+	bool Handler::framePeekMulti(const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload) {
+		u32 base = 0, count = 0;
+		if (!args.read(base) || !args.read(count) || args.remaining() < (u64)count * 2 * sizeof(u64)) {
+			return false;
+		}
+
+		std::vector<u64> offsets(count);
+		std::vector<u64> sizes(count);
+		u64 total = 0;
+		for (u32 i = 0; i < count; ++i) {
+			u64 offset = 0;
+			args.read(offset);
+			args.read(sizes[i]);
+			total += sizes[i];
+			if (!resolveFrameAddress(base, offset, offsets[i]) || total > Protocol::MaxFrameLength) {
+				return false;
+			}
+		}
+
+		return R_SUCCEEDED(readMulti(offsets, sizes, payload));
+	}
+
+	/**
+	 * @brief Write raw bytes.
+	 * @param The frame header.
+	 * @param Frame arguments: u32 base, u32 size, u64 offset, then size bytes.
+	 * @param[out] Unused.
+	 * @return false if the arguments are invalid.
+	 */
+	bool Handler::framePoke(const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload) {
+		u32 base = 0, size = 0;
+		u64 offset = 0, address = 0;
+		if (!args.read(base) || !args.read(size) || !args.read(offset) || !resolveFrameAddress(base, offset, address) || size == 0 || args.remaining() < size) {
+			return false;
+		}
+
+		poke(address, size, std::vector<char>(args.current(), args.current() + size));
+		return true;
+	}
+
+	/**
+	 * @brief Follow a pointer chain from main and read raw bytes at its end.
+	 * @param The frame header.
+	 * @param Frame arguments: u32 size, u32 jump count, s64 final jump, s64 main jump, then count * s64 jump.
+	 * @param[out] The bytes read.
+	 * @return false if the arguments are invalid, the chain resolved to 0, or the read failed.
+	 */
+	bool Handler::framePointerPeek(const Protocol::FrameHeader& header, Protocol::ArgReader& args, std::vector<char>& payload) {
+		u32 size = 0, count = 0;
+		s64 finalJump = 0, mainJump = 0;
+		if (!args.read(size) || !args.read(count) || !args.read(finalJump) || !args.read(mainJump) || args.remaining() < (u64)count * sizeof(s64)) {
+			return false;
+		}
+
+		if (size == 0 || size > Protocol::MaxFrameLength) {
+			return false;
+		}
+
+		std::vector<s64> jumps(count);
+		for (u32 i = 0; i < count; ++i) {
+			args.read(jumps[i]);
+		}
+
+		u64 address = followMainPointer(mainJump, jumps, payload);
+		if (address == 0) {
+			Logger::instance().log("framePointerPeek() value is 0, is your pointer chain correct?");
+			return false;
+		}
+
+		return R_SUCCEEDED(readRange(address + finalJump, size, payload));
+	}
+#pragma endregion Binary protocol v2.
 }
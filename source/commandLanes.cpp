@@ -0,0 +1,164 @@
+#include "defines.h"
+#include "commandLanes.h"
+#include "logger.h"
+
+namespace CommandLanes {
+    using namespace SbbLog;
+
+    /**
+     * @brief Start one worker per lane.
+     * @param Runs a request on its lane's worker, with scratch storage for its tokens.
+     */
+    void Lanes::start(RequestFunc handler) {
+        for (size_t i = 0; i < LaneCount; ++i) {
+            Worker& worker = m_workers[i];
+            worker.thread = std::thread([this, &worker, i, handler]() { run(worker, (Lane)i, handler); });
+        }
+    }
+
+    void Lanes::join() {
+        notifyAll();
+        for (Worker& worker : m_workers) {
+            if (worker.thread.joinable()) {
+                worker.thread.join();
+            }
+        }
+
+        clear();
+    }
+
+    /**
+     * @brief Queue a request on its lane. Requests on one lane run in the order they were pushed.
+     * Waits while the lane is full rather than dropping, so a burst of tagged commands slows the client down instead of losing replies.
+     * @param The lane. Must not be Lane::Barrier.
+     * @param The request.
+     * @return false if the connection stopped before the request could be queued.
+     */
+    bool Lanes::push(Lane lane, Request&& request) {
+        Worker& worker = m_workers[(size_t)lane];
+        worker.pending.fetch_add(1, std::memory_order_acq_rel);
+        while (!worker.queue.push(std::move(request))) {
+            if (m_stop || m_error) {
+                finish(worker, 1);
+                return false;
+            }
+
+            std::unique_lock<std::mutex> lock(m_idleMutex);
+            m_idleCv.wait_for(lock, std::chrono::milliseconds(1), [&]() { return !worker.queue.full() || m_stop || m_error; });
+        }
+
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.cv.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Wait until every lane has finished everything queued on it.
+     */
+    void Lanes::barrier() {
+        if (idle()) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        m_idleCv.wait(lock, [&]() { return idle() || m_stop || m_error; });
+    }
+
+    void Lanes::clear() {
+        for (Worker& worker : m_workers) {
+            drain(worker);
+        }
+    }
+
+    void Lanes::notifyAll() {
+        for (Worker& worker : m_workers) {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.cv.notify_all();
+        }
+
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        m_idleCv.notify_all();
+    }
+
+    std::string_view Lanes::laneName(Lane lane) {
+        switch (lane) {
+            case Lane::Memory: return "memory";
+            case Lane::Input: return "input";
+            case Lane::Capture: return "capture";
+            case Lane::System: return "system";
+            default: return "barrier";
+        }
+    }
+
+    void Lanes::run(Worker& worker, Lane lane, const RequestFunc& handler) {
+        std::string name(laneName(lane));
+        Logger::instance().log("Lane " + name + " thread starting...");
+        std::vector<std::string_view> tokens;
+        while (!m_stop) {
+            try {
+                Request request;
+                while (!m_error && worker.queue.pop(request)) {
+                    // One failed request mustn't take the lane down, or every later push and barrier would wait on it forever.
+                    try {
+                        handler(request, tokens);
+                    } catch (const std::exception& e) {
+                        Logger::instance().log("Lane " + name + " request exception: ", e.what());
+                    } catch (...) {
+                        Logger::instance().log("Unknown lane " + name + " request exception.", "Unknown error.");
+                    }
+
+                    finish(worker, 1);
+                }
+
+                std::unique_lock<std::mutex> lock(worker.mutex);
+                worker.cv.wait(lock, [&]() { return !worker.queue.empty() || m_error || m_stop; });
+                if (m_error || m_stop) {
+                    lock.unlock();
+                    drain(worker);
+                }
+            } catch (const std::exception& e) {
+                Logger::instance().log("Lane " + name + " thread exception: ", e.what());
+                break;
+            } catch (...) {
+                Logger::instance().log("Unknown lane " + name + " thread exception.", "Unknown error.");
+                break;
+            }
+        }
+
+        Logger::instance().log("Lane " + name + " thread exiting.");
+    }
+
+    /**
+     * @brief Mark requests on a lane as done and wake anyone waiting for a barrier or for room in the lane.
+     */
+    void Lanes::finish(Worker& worker, u32 count) {
+        worker.pending.fetch_sub(count, std::memory_order_acq_rel);
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        m_idleCv.notify_all();
+    }
+
+    /**
+     * @brief Drop everything queued on a lane without running it.
+     */
+    void Lanes::drain(Worker& worker) {
+        u32 count = 0;
+        Request request;
+        while (worker.queue.pop(request)) {
+            ++count;
+        }
+
+        if (count > 0) {
+            finish(worker, count);
+        }
+    }
+
+    bool Lanes::idle() const {
+        for (const Worker& worker : m_workers) {
+            if (worker.pending.load(std::memory_order_acquire) != 0) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
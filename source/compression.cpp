@@ -0,0 +1,214 @@
+#include "defines.h"
+#include "compression.h"
+#include <cstring>
+
+namespace Compression {
+    static inline u32 read32(const u8* ptr) {
+        u32 value;
+        std::memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    static inline u64 read64(const u8* ptr) {
+        u64 value;
+        std::memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    /**
+     * @brief Worst-case size of a compressed block.
+     * @param The input size.
+     * @return The maximum number of bytes compress() can append.
+     */
+    size_t Lz4::compressBound(size_t size) {
+        return size + (size / 255) + 16;
+    }
+
+    /**
+     * @brief Compress a buffer into a single LZ4 block with a greedy single-probe hash search.
+     * Incompressible input is skipped over progressively faster, so the worst case costs little more than a copy.
+     * @param The input data.
+     * @param The input size.
+     * @param[out] Buffer the compressed block is appended to.
+     */
+    void Lz4::compress(const char* data, size_t size, std::vector<char>& out) {
+        size_t start = out.size();
+        out.resize(start + compressBound(size));
+        const u8* src = reinterpret_cast<const u8*>(data);
+        u8* op = reinterpret_cast<u8*>(out.data()) + start;
+        size_t anchor = 0;
+
+        if (size > MatchFindLimit) {
+            // Kept per thread and cleared per call, so compressing every streamed chunk doesn't allocate a fresh 16 KiB table each time.
+            static thread_local std::vector<u32> table;
+            table.assign(1 << HashLog, 0);
+            const size_t matchLimit = size - LastLiterals;
+            const size_t searchLimit = size - MatchFindLimit;
+            size_t ip = 0;
+            u32 misses = 0;
+            while (ip <= searchLimit) {
+                u32 sequence = read32(src + ip);
+                u32 hash = (sequence * 2654435761U) >> (32 - HashLog);
+                size_t ref = table[hash];
+                table[hash] = (u32)ip;
+                if (ref >= ip || ip - ref > MaxDistance || read32(src + ref) != sequence) {
+                    ip += 1 + (misses++ >> SkipTrigger);
+                    continue;
+                }
+
+                size_t matchLength = MinMatch;
+                while (ip + matchLength + sizeof(u64) <= matchLimit) {
+                    u64 diff = read64(src + ip + matchLength) ^ read64(src + ref + matchLength);
+                    if (diff != 0) {
+                        matchLength += __builtin_ctzll(diff) >> 3;
+                        break;
+                    }
+
+                    matchLength += sizeof(u64);
+                }
+
+                while (ip + matchLength < matchLimit && src[ip + matchLength] == src[ref + matchLength]) {
+                    ++matchLength;
+                }
+
+                while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                    --ip;
+                    --ref;
+                    ++matchLength;
+                }
+
+                op = writeSequence(op, src + anchor, ip - anchor, ip - ref, matchLength);
+                ip += matchLength;
+                anchor = ip;
+                misses = 0;
+            }
+        }
+
+        op = writeSequence(op, src + anchor, size - anchor, 0, 0);
+        out.resize(op - reinterpret_cast<u8*>(out.data()));
+    }
+
+    /**
+     * @brief Decompress a single LZ4 block.
+     * @param The compressed block.
+     * @param The compressed size.
+     * @param[out] Output buffer.
+     * @param The exact decompressed size.
+     * @return true if the block was valid and filled the output exactly.
+     */
+    bool Lz4::decompress(const char* data, size_t size, char* out, size_t outSize) {
+        const u8* ip = reinterpret_cast<const u8*>(data);
+        const u8* end = ip + size;
+        u8* op = reinterpret_cast<u8*>(out);
+        u8* const base = op;
+        u8* const outEnd = op + outSize;
+
+        auto readLength = [&](size_t& length) {
+            u8 byte = 255;
+            while (byte == 255) {
+                if (ip >= end) {
+                    return false;
+                }
+
+                byte = *ip++;
+                length += byte;
+            }
+
+            return true;
+        };
+
+        while (ip < end) {
+            u8 token = *ip++;
+            size_t literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(literalLength)) {
+                return false;
+            }
+
+            if (literalLength > (size_t)(end - ip) || literalLength > (size_t)(outEnd - op)) {
+                return false;
+            }
+
+            std::memcpy(op, ip, literalLength);
+            op += literalLength;
+            ip += literalLength;
+            if (ip == end) {
+                break;
+            }
+
+            if (end - ip < 2) {
+                return false;
+            }
+
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            size_t matchLength = token & 0x0F;
+            if ((matchLength == 15 && !readLength(matchLength)) || offset == 0 || offset > (size_t)(op - base)) {
+                return false;
+            }
+
+            matchLength += MinMatch;
+            if (matchLength > (size_t)(outEnd - op)) {
+                return false;
+            }
+
+            // Matches may overlap their own output, so copy forwards byte by byte.
+            const u8* match = op - offset;
+            for (size_t i = 0; i < matchLength; ++i) {
+                op[i] = match[i];
+            }
+
+            op += matchLength;
+        }
+
+        return op == outEnd;
+    }
+
+    /**
+     * @brief Write one LZ4 sequence: token, literals, and a match unless it's the final literal run.
+     * @param Output pointer.
+     * @param Literal bytes.
+     * @param Number of literal bytes.
+     * @param Match offset.
+     * @param Match length, or 0 for the final literal run.
+     * @return The new output pointer.
+     */
+    u8* Lz4::writeSequence(u8* op, const u8* literals, size_t literalLength, size_t offset, size_t matchLength) {
+        u8* token = op++;
+        *token = (u8)((literalLength < 15 ? literalLength : 15) << 4);
+        if (literalLength >= 15) {
+            op = writeLength(op, literalLength - 15);
+        }
+
+        std::memcpy(op, literals, literalLength);
+        op += literalLength;
+        if (matchLength == 0) {
+            return op;
+        }
+
+        *op++ = (u8)(offset & 0xFF);
+        *op++ = (u8)(offset >> 8);
+        size_t length = matchLength - MinMatch;
+        *token |= (u8)(length < 15 ? length : 15);
+        if (length >= 15) {
+            op = writeLength(op, length - 15);
+        }
+
+        return op;
+    }
+
+    /**
+     * @brief Write the 255-run extension of a literal or match length.
+     * @param Output pointer.
+     * @param Length beyond the 15 stored in the token.
+     * @return The new output pointer.
+     */
+    u8* Lz4::writeLength(u8* op, size_t length) {
+        while (length >= 255) {
+            *op++ = 255;
+            length -= 255;
+        }
+
+        *op++ = (u8)length;
+        return op;
+    }
+}
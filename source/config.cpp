@@ -0,0 +1,83 @@
+#include "defines.h"
+#include "config.h"
+#include "logger.h"
+#include "util.h"
+#include <fstream>
+#include <string>
+
+namespace Config {
+    using namespace SbbLog;
+
+    static constexpr const char* ConfigPath = "sdmc:/atmosphere/contents/430000000000000B/config.cfg";
+
+    /**
+     * @brief Read config.cfg and fix the transport for this boot. Call once, after sdmc is mounted and before the connection is set up.
+     */
+    void Settings::load() {
+        auto snapshot = parse();
+        m_transport.store(snapshot->transport, std::memory_order_relaxed);
+        m_snapshot.store(std::move(snapshot), std::memory_order_release);
+    }
+
+    /**
+     * @brief Re-read config.cfg and publish a new snapshot. Readers holding the previous snapshot keep it until they drop it.
+     * @return The new snapshot.
+     */
+    std::shared_ptr<const Snapshot> Settings::reload() {
+        auto snapshot = parse();
+        m_snapshot.store(snapshot, std::memory_order_release);
+        if (snapshot->transport != transport()) {
+            Logger::instance().log("Config reloaded. Transport changed to " + std::string(transportName(snapshot->transport)) + ", restart to apply.");
+        } else {
+            Logger::instance().log("Config reloaded.");
+        }
+
+        return snapshot;
+    }
+
+    /**
+     * @brief Read the next line of config.cfg without trailing whitespace.
+     * @param The open file.
+     * @param[out] The line.
+     * @return false at the end of the file.
+     */
+    static bool readLine(std::ifstream& cfg, std::string& line) {
+        if (!std::getline(cfg, line)) {
+            return false;
+        }
+
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) {
+            line.pop_back();
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Parse config.cfg. The first line selects the transport; anything other than "usb", or a missing file, means WiFi.
+     * Later lines are optional "key=value" settings: "udpPort={port}" enables the UDP side channel.
+     * @return The parsed snapshot.
+     */
+    std::shared_ptr<const Snapshot> Settings::parse() {
+        auto snapshot = std::make_shared<Snapshot>();
+        std::ifstream cfg(ConfigPath);
+        if (!cfg.is_open()) {
+            Logger::instance().log("Config file not found, defaulting to wifi.");
+            return snapshot;
+        }
+
+        std::string line;
+        if (readLine(cfg, line) && line == "usb") {
+            snapshot->transport = Transport::Usb;
+        }
+
+        while (readLine(cfg, line)) {
+            u64 port = 0;
+            if (line.starts_with("udpPort=") && Util::Utils::parseInt(std::string_view(line).substr(8), port) && port <= 0xFFFF) {
+                snapshot->udpPort = (u16)port;
+            }
+        }
+
+        return snapshot;
+    }
+}
@@ -216,7 +216,7 @@ namespace ControllerCommands {
      * @brief Set the controller type from parameters.
      * @param Parameters vector.
      */
-    void Controller::setControllerType(const std::vector<std::string>& params) {
+    void Controller::setControllerType(Args params) {
         if (params.size() < 2) {
             Logger::instance().log("setControllerType() params size is less than 2.");
             return;
@@ -291,12 +291,15 @@ namespace ControllerCommands {
             //  Now is the best time to send the finished messaged for the previous command.
             if (m_ccCurrentCommand.seqnum != 0){
                 Logger::instance().log("cqSendState() command finished with seqnum: " + std::to_string(m_ccCurrentCommand.seqnum));
-                std::string res = "cqCommandFinished " + std::to_string(m_ccCurrentCommand.seqnum) + "\r\n";
-                if (!senderQueue.full()) {
-                    senderQueue.push(std::vector<char>(res.begin(), res.end()));
-                    senderCv.notify_one();
-                } else {
-                    Logger::instance().log("Sender queue full, dropping command finished message.");
+                // Commands scheduled over the UDP side channel are reported there instead.
+                if (!m_ccFinishedSink || !m_ccFinishedSink(m_ccCurrentCommand.seqnum)) {
+                    std::string res = "cqCommandFinished " + std::to_string(m_ccCurrentCommand.seqnum) + "\r\n";
+                    if (!senderQueue.full()) {
+                        senderQueue.push(makeEventMessage(res));
+                        senderCv.notify_one();
+                    } else {
+                        Logger::instance().log("Sender queue full, dropping command finished message.");
+                    }
                 }
             }
 
@@ -395,6 +398,14 @@ namespace ControllerCommands {
         m_replaceOnNext = true;
     }
 
+    /**
+     * @brief Route "cqCommandFinished" through another channel first, such as the UDP side channel. Set it before the controller thread starts.
+     * @param The sink, which returns false for commands it didn't schedule.
+     */
+    void Controller::cqSetFinishedSink(FinishedSink sink) {
+        m_ccFinishedSink = std::move(sink);
+    }
+
     /**
      * @brief Notify all PA threads.
      */
@@ -415,32 +426,8 @@ namespace ControllerCommands {
      * @param The string argument.
      * @return The button value, or -1 if not found.
      */
-    int Controller::parseStringToButton(const std::string& arg) {
-        auto it = Controller::m_button.find(arg);
-        if (it != Controller::m_button.end()) {
-            return it->second;
-        } else {
-            Logger::instance().log("parseStringToButton() button not found (" + arg + ").");
-            return -1;
-        }
-    }
-
-    /**
-     * @brief Parse a string to a stick value.
-     * @param The string argument.
-     * @return The stick value, or -1 if not found.
-     */
-    int Controller::parseStringToStick(const std::string& arg) {
-        auto it = Controller::m_stick.find(arg);
-        if (it != Controller::m_stick.end()) {
-            return it->second;
-        } else {
-            Logger::instance().log("parseStringToStick() stick not found (" + arg + ").");
-            return -1;
-        }
-    }
-
-    std::unordered_map<std::string, int> Controller::m_button {
+    int Controller::parseStringToButton(std::string_view arg) {
+        static constexpr auto buttons = Dispatch::makeTable<std::string_view, int>({
             { "A", HidNpadButton_A },
             { "B", HidNpadButton_B },
             { "X", HidNpadButton_X },
@@ -464,11 +451,35 @@ namespace ControllerCommands {
             { "HOME", BIT(18) }, // HiddbgNpadButton_HOME
             { "CAPTURE", BIT(19) }, // HiddbgNpadButton_CAPTURE
             { "PALMA", HidNpadButton_Palma },
-            { "UNUSED", BIT(20)},
-    };
+            { "UNUSED", BIT(20) }
+        });
 
-    std::unordered_map<std::string, int> Controller::m_stick {
-        { "LEFT", Joystick::Left },
-        { "RIGHT", Joystick::Right },
-    };
+        const int* button = buttons.find(arg);
+        if (button) {
+            return *button;
+        } else {
+            Logger::instance().log("parseStringToButton() button not found (" + std::string(arg) + ").");
+            return -1;
+        }
+    }
+
+    /**
+     * @brief Parse a string to a stick value.
+     * @param The string argument.
+     * @return The stick value, or -1 if not found.
+     */
+    int Controller::parseStringToStick(std::string_view arg) {
+        static constexpr auto sticks = Dispatch::makeTable<std::string_view, int>({
+            { "LEFT", Joystick::Left },
+            { "RIGHT", Joystick::Right }
+        });
+
+        const int* stick = sticks.find(arg);
+        if (stick) {
+            return *stick;
+        } else {
+            Logger::instance().log("parseStringToStick() stick not found (" + std::string(arg) + ").");
+            return -1;
+        }
+    }
 }
@@ -2,6 +2,7 @@
 #include "socketConnection.h"
 #include "usbConnection.h"
 #include "util.h"
+#include "config.h"
 #include "connection.h"
 #include <switch.h>
 #include "logger.h"
@@ -114,6 +115,7 @@ extern "C" {
             fatalThrow(rc);
         }
 
+        Config::Settings::instance().load();
         setUpConnection();
         if (R_FAILED(m_connection->initialize(rc))) {
             fatalThrow(rc);
@@ -2,7 +2,10 @@
 #include "memoryCommands.h"
 #include "moduleBase.h"
 #include "util.h"
+#include "bufferPool.h"
+#include "protocol.h"
 #include "logger.h"
+#include <algorithm>
 #include <cstring>
 
 namespace MemoryCommands {
@@ -17,27 +20,209 @@ namespace MemoryCommands {
      * @param[out] Output buffer for the read data.
      */
     void Vision::peek(u64 offset, u64 size, std::vector<char>& buffer) {
+        // USB backwards compatibility mode size-prefixes every send, so a chunked response would be read as several replies.
+        if (size > MAX_LINE_LENGTH && m_responseStream && (!g_enableBackwardsCompat || !Utils::isUSB())) {
+            peekStreamed(offset, size, buffer);
+            return;
+        }
+
+        if (m_limitWholeReads && size > Protocol::MaxFrameLength) {
+            Logger::instance().log("peek() size too large to return whole. Size=" + std::to_string(size));
+            buffer.clear();
+            return;
+        }
+
+        bool hex = g_enableBackwardsCompat && !Utils::isUSB();
+        BufferPool::Pool::instance().reserve(buffer, hex ? size * 2 : size);
+        Result rc = readRange(offset, size, buffer);
+        if (R_FAILED(rc)) {
+            buffer.assign(size, 0);
+        }
+
+        if (hex) {
+            Utils::hexify(buffer);
+        }
+    }
+
+    /**
+     * @brief Read memory in MAX_LINE_LENGTH chunks and push each one to the sender thread as soon as it's encoded,
+     * so peak memory doesn't depend on the requested size and sending overlaps with the next read. Chunks that fail to read are zero-filled.
+     * @param The memory offset.
+     * @param The number of bytes to read.
+     * @param[out] Left empty; the whole response goes through the response stream.
+     * @param Bytes sent ahead of the data, such as a binary frame header. When empty, the data is sent as a text response: hexified for WiFi backwards compatibility and line-terminated.
+     */
+    void Vision::peekStreamed(u64 offset, u64 size, std::vector<char>& buffer, std::vector<char> header) {
+        DebugSession session(*this);
+        m_responseStreaming = true;
+        buffer.clear();
+        bool text = header.empty();
+        if (!text && !m_responseStream(std::move(header))) {
+            m_responseStreaming = false;
+            return;
+        }
+
+        u64 total = 0;
+        while (total < size) {
+            u64 receive = std::min<u64>(size - total, MAX_LINE_LENGTH);
+            std::vector<char> chunk = BufferPool::Pool::instance().acquire((receive * 2) + 1);
+            if (R_FAILED(readRange(offset + total, receive, chunk))) {
+                chunk.assign(receive, 0);
+            }
+
+            if (text && g_enableBackwardsCompat && !Utils::isUSB()) {
+                Utils::hexify(chunk);
+            }
+
+            total += receive;
+            if (text && total == size) {
+                chunk.push_back('\n');
+            }
+
+            if (!m_responseStream(std::move(chunk))) {
+                Logger::instance().log("peekStreamed() response stream closed. Sent=" + std::to_string(total - receive) + ", Size=" + std::to_string(size));
+                break;
+            }
+        }
+
+        m_responseStreaming = false;
+    }
+
+    /**
+     * @brief Read a contiguous range in MAX_LINE_LENGTH chunks, split at region boundaries.
+     * @param The memory offset.
+     * @param The number of bytes to read.
+     * @param[out] Output buffer for the read data, resized to size.
+     * @return The result of the failed read, or success.
+     */
+    Result Vision::readRange(u64 offset, u64 size, std::vector<char>& buffer) {
+        DebugSession session(*this);
         u64 total = 0;
         u64 remainder = size;
         buffer.resize(size);
 
+        if (!checkRange(offset, size, true)) {
+            Logger::instance().log("readRange() range is not mapped readable. Offset=" + std::to_string(offset) + ", Size=" + std::to_string(size));
+            return MAKERESULT(Module_Kernel, KernelError_InvalidCurrentMemory);
+        }
+
         while (remainder > 0) {
-            u64 receive = remainder > MAX_LINE_LENGTH ? MAX_LINE_LENGTH : remainder;
+            u64 receive = std::min<u64>({ remainder, MAX_LINE_LENGTH, getRegionEnd(offset + total) - (offset + total) });
             remainder -= receive;
-            Result rc = readMem(buffer, offset + total, receive);
+            Result rc = readMem(buffer, offset + total, receive, total);
             if (R_FAILED(rc)) {
-                Logger::instance().log("peek() readMem() failed. Offset=" + std::to_string(offset + total) + ", Size=" + std::to_string(receive), std::to_string(R_DESCRIPTION(rc)));
-                buffer.assign(size, 0);
-                break;
+                Logger::instance().log("readRange() readMem() failed. Offset=" + std::to_string(offset + total) + ", Size=" + std::to_string(receive), std::to_string(R_DESCRIPTION(rc)));
+                return rc;
             }
             total += receive;
         }
 
+        return 0;
+    }
+
+    /**
+     * @brief Read a region and return only the spans that changed since the snapshot the client last received. Each client has its own snapshots.
+     * Response: u32 seq, u32 span count, then per span u32 offset, u32 length and the bytes, all little-endian.
+     * If lastSeq doesn't match the stored snapshot, the whole region is returned as one span so the client can resync.
+     * @param The memory offset.
+     * @param The number of bytes to read.
+     * @param The sequence number of the last response the client applied, 0 if none.
+     * @param[out] Output buffer for the delta.
+     */
+    void Vision::peekDelta(u64 offset, u64 size, u32 lastSeq, std::vector<char>& buffer) {
+        auto appendU32 = [&buffer](u32 value) {
+            const char* bytes = reinterpret_cast<const char*>(&value);
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+        };
+
+        buffer.clear();
+        DeltaSnapshots& snapshots = m_deltaSnapshots[&clientSettings()];
+        if (snapshots.pid != m_metaData.pid) {
+            snapshots.regions.clear();
+            snapshots.pid = m_metaData.pid;
+        }
+
+        auto key = std::make_pair(offset, size);
+        auto it = snapshots.regions.find(key);
+        std::vector<char> current;
+        if (size == 0 || size > DeltaSnapshotMaxSize || (it == snapshots.regions.end() && snapshots.regions.size() >= DeltaSnapshotCapacity)) {
+            Logger::instance().log("peekDelta() region too large or too many regions registered. Offset=" + std::to_string(offset) + ", Size=" + std::to_string(size));
+            appendU32(0);
+            appendU32(0);
+        } else if (R_FAILED(readRange(offset, size, current))) {
+            if (it != snapshots.regions.end()) {
+                snapshots.regions.erase(it);
+            }
+
+            appendU32(0);
+            appendU32(0);
+        } else {
+            bool full = it == snapshots.regions.end() || it->second.seq != lastSeq;
+            if (it == snapshots.regions.end()) {
+                it = snapshots.regions.emplace(key, DeltaSnapshot { {}, 0 }).first;
+            }
+
+            DeltaSnapshot& snapshot = it->second;
+            if (++snapshot.seq == 0) {
+                snapshot.seq = 1;
+            }
+
+            appendU32(snapshot.seq);
+            appendU32(0);
+            u32 spanCount = 0;
+            auto appendSpan = [&](u64 start, u64 end) {
+                appendU32((u32)start);
+                appendU32((u32)(end - start));
+                buffer.insert(buffer.end(), current.begin() + start, current.begin() + end);
+                ++spanCount;
+            };
+
+            if (full) {
+                appendSpan(0, size);
+            } else {
+                u64 i = 0;
+                while (i < size) {
+                    if (i + sizeof(u64) <= size && std::memcmp(current.data() + i, snapshot.data.data() + i, sizeof(u64)) == 0) {
+                        i += sizeof(u64);
+                        continue;
+                    }
+
+                    if (current[i] == snapshot.data[i]) {
+                        ++i;
+                        continue;
+                    }
+
+                    // Extend the span until DeltaSpanMergeGap unchanged bytes in a row.
+                    u64 start = i;
+                    u64 end = i + 1;
+                    for (u64 j = end; j < size && j - end < DeltaSpanMergeGap; ++j) {
+                        if (current[j] != snapshot.data[j]) {
+                            end = j + 1;
+                        }
+                    }
+
+                    appendSpan(start, end);
+                    i = end;
+                }
+            }
+
+            std::memcpy(buffer.data() + sizeof(u32), &spanCount, sizeof(spanCount));
+            snapshot.data.swap(current);
+        }
+
         if (g_enableBackwardsCompat && !Utils::isUSB()) {
             Utils::hexify(buffer);
         }
     }
 
+    /**
+     * @brief Drop the current client's delta peek snapshots.
+     */
+    void Vision::clearDeltaSnapshots() {
+        std::lock_guard<std::recursive_mutex> lock(m_debugMutex);
+        m_deltaSnapshots.erase(&clientSettings());
+    }
+
     /**
      * @brief Read multiple memory regions into the buffer.
      * @param Vector of memory offsets.
@@ -45,28 +230,123 @@ namespace MemoryCommands {
      * @param[out] Output buffer for the read data.
      */
     void Vision::peekMulti(const std::vector<u64>& offsets, const std::vector<u64>& sizes, std::vector<char>& buffer) {
-        u64 ofs = 0;
         u64 totalSize = 0;
-        int size = (int)sizes.size();
-        for (int i = 0; i < size; i++) {
+        for (u64 size : sizes) {
+            totalSize += size;
+        }
+
+        if (m_limitWholeReads && totalSize > Protocol::MaxFrameLength) {
+            Logger::instance().log("peekMulti() size too large to return whole. Size=" + std::to_string(totalSize));
+            buffer.clear();
+            return;
+        }
+
+        Result rc = readMulti(offsets, sizes, buffer);
+        if (R_FAILED(rc)) {
+            buffer.assign(buffer.size(), 0);
+        }
+
+        if (g_enableBackwardsCompat && !Utils::isUSB()) {
+            Utils::hexify(buffer);
+        }
+    }
+
+    /**
+     * @brief Sort the requested ranges and merge neighbours into as few kernel reads as possible.
+     * Ranges merge when they overlap, start on the page the current read ends on, or are within m_peekGapThreshold bytes of it.
+     * @param Vector of memory offsets.
+     * @param Vector of sizes for each region.
+     * @return The read plan.
+     */
+    Vision::ReadPlan Vision::planReads(const std::vector<u64>& offsets, const std::vector<u64>& sizes) const {
+        ReadPlan plan;
+        size_t count = std::min(offsets.size(), sizes.size());
+        plan.order.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (sizes[i] != 0) {
+                plan.order.push_back(i);
+            }
+        }
+
+        std::stable_sort(plan.order.begin(), plan.order.end(), [&](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+        for (size_t i = 0; i < plan.order.size(); ++i) {
+            u64 start = offsets[plan.order[i]];
+            u64 end = start + sizes[plan.order[i]];
+            if (!plan.spans.empty()) {
+                ReadSpan& span = plan.spans.back();
+                u64 spanEnd = span.offset + span.size;
+                u64 pageEnd = ((spanEnd - 1) | (PageSize - 1)) + 1;
+                u64 mergedEnd = std::max(spanEnd, end);
+                bool adjacent = start < pageEnd || start - spanEnd <= m_peekGapThreshold;
+                if (adjacent && mergedEnd - span.offset <= MAX_LINE_LENGTH && mergedEnd <= getRegionEnd(span.offset)) {
+                    span.size = mergedEnd - span.offset;
+                    ++span.count;
+                    continue;
+                }
+            }
+
+            plan.spans.push_back({ start, end - start, i, 1 });
+        }
+
+        return plan;
+    }
+
+    /**
+     * @brief Read multiple memory regions with coalesced kernel reads, scattering results into the buffer in request order.
+     * @param Vector of memory offsets.
+     * @param Vector of sizes for each region.
+     * @param[out] Output buffer for the read data, resized to the sum of sizes.
+     * @return The result of the first failed read, or success.
+     */
+    Result Vision::readMulti(const std::vector<u64>& offsets, const std::vector<u64>& sizes, std::vector<char>& buffer) {
+        DebugSession session(*this);
+        size_t count = std::min(offsets.size(), sizes.size());
+        std::vector<u64> dest(count);
+        u64 totalSize = 0;
+        for (size_t i = 0; i < count; ++i) {
+            dest[i] = totalSize;
             totalSize += sizes[i];
         }
 
         buffer.resize(totalSize * sizeof(u8));
-        int count = (int)offsets.size();
-        for (int i = 0; i < count; i++) {
-            Result rc = readMem(buffer, offsets[i], sizes[i], ofs);
-            if (R_FAILED(rc)) {
-                Logger::instance().log("peekMulti() readMem() failed. Offset=" + std::to_string(offsets[i]) + ", Size=" + std::to_string(sizes[i]), std::to_string(R_DESCRIPTION(rc)));
-                buffer.assign(totalSize * sizeof(u8), 0);
-                break;
+        for (size_t i = 0; i < count; ++i) {
+            if (sizes[i] != 0 && !checkRange(offsets[i], sizes[i], true)) {
+                Logger::instance().log("readMulti() range is not mapped readable. Offset=" + std::to_string(offsets[i]) + ", Size=" + std::to_string(sizes[i]));
+                return MAKERESULT(Module_Kernel, KernelError_InvalidCurrentMemory);
             }
-            ofs += sizes[i];
         }
 
-        if (g_enableBackwardsCompat && !Utils::isUSB()) {
-            Utils::hexify(buffer);
+        ReadPlan plan = planReads(offsets, sizes);
+        std::vector<char> scratch;
+        for (const auto& span : plan.spans) {
+            Result rc = 0;
+            if (span.count == 1) {
+                rc = readMem(buffer, span.offset, span.size, dest[plan.order[span.first]]);
+            } else {
+                scratch.resize(span.size);
+                rc = readMem(scratch, span.offset, span.size);
+                if (R_SUCCEEDED(rc)) {
+                    for (size_t i = span.first; i < span.first + span.count; ++i) {
+                        size_t idx = plan.order[i];
+                        std::memcpy(buffer.data() + dest[idx], scratch.data() + (offsets[idx] - span.offset), sizes[idx]);
+                    }
+                } else {
+                    // A merged read may bridge an unmapped gap, so fall back to the individual ranges.
+                    rc = 0;
+                    for (size_t i = span.first; i < span.first + span.count && R_SUCCEEDED(rc); ++i) {
+                        size_t idx = plan.order[i];
+                        rc = readMem(buffer, offsets[idx], sizes[idx], dest[idx]);
+                    }
+                }
+            }
+
+            if (R_FAILED(rc)) {
+                Logger::instance().log("readMulti() readMem() failed. Offset=" + std::to_string(span.offset) + ", Size=" + std::to_string(span.size), std::to_string(R_DESCRIPTION(rc)));
+                return rc;
+            }
         }
+
+        return 0;
     }
 
     /**
@@ -76,22 +356,90 @@ namespace MemoryCommands {
      * @param Input buffer containing data to write.
      */
     void Vision::poke(u64 offset, u64 size, const std::vector<char>& buffer) {
+        DebugSession session(*this);
+        if (!checkRange(offset, size, false)) {
+            Logger::instance().log("poke() range is not mapped. Offset=" + std::to_string(offset) + ", Size=" + std::to_string(size));
+            return;
+        }
+
         writeMem(offset, size, buffer);
     }
 
     /**
      * @brief Follow a pointer chain starting from main, applying jumps, and return the final address.
+     * When the pointer cache is enabled, a chain resolved within the TTL is revalidated by re-reading only its last hop.
      * @param The base pointer offset.
      * @param Vector of jumps to follow.
      * @param[out] Buffer used for intermediate reads.
      * @return The final address after following the pointer chain.
      */
     u64 Vision::followMainPointer(const s64& main, const std::vector<s64>& jumps, std::vector<char>& buffer) {
+        DebugSession session(*this);
+        u64 lastHop = 0;
+        if (!m_pointerCacheEnabled) {
+            flushPointerCache();
+            return walkMainPointer(main, jumps, buffer, lastHop);
+        }
+
+        if (m_pointerCachePid != m_metaData.pid || m_pointerCacheHeapBase != m_metaData.heap_base) {
+            flushPointerCache();
+            m_pointerCachePid = m_metaData.pid;
+            m_pointerCacheHeapBase = m_metaData.heap_base;
+        }
+
+        std::vector<s64> key;
+        key.reserve(jumps.size() + 1);
+        key.push_back(main);
+        key.insert(key.end(), jumps.begin(), jumps.end());
+
+        u64 now = armGetSystemTick();
+        auto it = m_pointerCache.find(key);
+        if (it != m_pointerCache.end()) {
+            if (now < it->second.expiresTick) {
+                u64 offset = 0;
+                buffer.resize(sizeof(u64));
+                Result rc = readMem(buffer, it->second.lastHop, sizeof(u64));
+                if (R_SUCCEEDED(rc)) {
+                    std::memcpy(&offset, buffer.data(), sizeof(u64));
+                }
+
+                if (offset != 0) {
+                    ++m_pointerCacheHits;
+                    return offset;
+                }
+            }
+
+            m_pointerCache.erase(it);
+        }
+
+        ++m_pointerCacheMisses;
+        u64 offset = walkMainPointer(main, jumps, buffer, lastHop);
+        if (offset != 0) {
+            if (m_pointerCache.size() >= PointerCacheCapacity) {
+                m_pointerCache.clear();
+            }
+
+            m_pointerCache[std::move(key)] = { lastHop, now + armNsToTicks(m_pointerCacheTtl * 1000000ULL) };
+        }
+
+        return offset;
+    }
+
+    /**
+     * @brief Walk a pointer chain from main, one debug read per hop.
+     * @param The base pointer offset.
+     * @param Vector of jumps to follow.
+     * @param[out] Buffer used for intermediate reads.
+     * @param[out] The address of the final pointer read.
+     * @return The final address after following the pointer chain.
+     */
+    u64 Vision::walkMainPointer(const s64& main, const std::vector<s64>& jumps, std::vector<char>& buffer, u64& lastHop) {
         u64 offset = 0;
         u64 size = sizeof(u64);
         buffer.resize(size);
 
-        Result rc = readMem(buffer, m_metaData.main_nso_base + main, size);
+        lastHop = m_metaData.main_nso_base + main;
+        Result rc = readMem(buffer, lastHop, size);
         if (R_FAILED(rc)) {
             Logger::instance().log("followMainPointer() initial readMem() failed. Main=" + std::to_string(main), std::to_string(R_DESCRIPTION(rc)));
             return 0;
@@ -100,7 +448,8 @@ namespace MemoryCommands {
         std::memcpy(&offset, buffer.data(), size);
         int count = (int)jumps.size();
         for (int i = 0; i < count; i++) {
-            rc = readMem(buffer, offset + jumps[i], size);
+            lastHop = offset + jumps[i];
+            rc = readMem(buffer, lastHop, size);
             if (R_FAILED(rc)) {
                 Logger::instance().log("followMainPointer() readMem() failed. Offset=" + std::to_string(offset) + ", Jump=" + std::to_string(jumps[i]), std::to_string(R_DESCRIPTION(rc)));
                 return 0;
@@ -115,6 +464,134 @@ namespace MemoryCommands {
         return offset;
     }
 
+    /**
+     * @brief Drop every cached pointer chain.
+     */
+    void Vision::flushPointerCache() {
+        m_pointerCache.clear();
+    }
+
+    /**
+     * @brief Get the mapped regions of the application, enumerating them with svcQueryDebugProcessMemory when the process has changed.
+     * @param Force the map to be enumerated again.
+     * @return Mapped regions sorted by address. Empty if enumeration failed.
+     */
+    const std::vector<Vision::MemoryRegion>& Vision::getRegionMap(bool refresh) {
+        if (!refresh && m_regionMapValid && m_regionMapPid == m_metaData.pid) {
+            return m_regions;
+        }
+
+        DebugSession session(*this);
+        m_regions.clear();
+        m_regionMapValid = false;
+        m_regionMapPid = m_metaData.pid;
+        m_regionMapTick = armGetSystemTick();
+        if (!attach()) {
+            Logger::instance().log("getRegionMap() attach() failed.");
+            return m_regions;
+        }
+
+        u64 addr = 0;
+        while (true) {
+            MemoryInfo info {};
+            u32 pageInfo = 0;
+            Result rc = svcQueryDebugProcessMemory(&info, &pageInfo, m_debugHandle, addr);
+            if (R_FAILED(rc)) {
+                Logger::instance().log("getRegionMap() svcQueryDebugProcessMemory() failed. Addr=" + std::to_string(addr), std::to_string(R_DESCRIPTION(rc)));
+                break;
+            }
+
+            if (info.type != MemType_Unmapped) {
+                m_regions.push_back({ info.addr, info.size, (u32)info.type, (u32)info.perm });
+            }
+
+            u64 next = info.addr + info.size;
+            if (info.size == 0 || next <= addr) {
+                break;
+            }
+
+            addr = next;
+        }
+
+        m_regionMapValid = !m_regions.empty();
+        return m_regions;
+    }
+
+    /**
+     * @brief Check a range against the region map. A failed check re-enumerates the map at most once per RegionMapRefreshMs, since the application may have mapped more memory.
+     * @param The memory offset.
+     * @param The number of bytes.
+     * @param If true, every byte must be readable. Otherwise it only needs to be mapped.
+     * @return true if the range is valid or the map is unavailable, false otherwise.
+     */
+    bool Vision::checkRange(u64 offset, u64 size, bool requireRead) {
+        getRegionMap();
+        if (!m_regionMapValid || rangeInRegions(offset, size, requireRead)) {
+            return true;
+        }
+
+        if (armTicksToNs(armGetSystemTick() - m_regionMapTick) < RegionMapRefreshMs * 1000000ULL) {
+            return false;
+        }
+
+        getRegionMap(true);
+        return !m_regionMapValid || rangeInRegions(offset, size, requireRead);
+    }
+
+    /**
+     * @brief Get the end address of the region containing the offset.
+     * @param The memory offset.
+     * @return The end of the region, or UINT64_MAX if the offset isn't in a known region.
+     */
+    u64 Vision::getRegionEnd(u64 offset) const {
+        const MemoryRegion* region = findRegion(offset);
+        return region ? region->addr + region->size : UINT64_MAX;
+    }
+
+    /**
+     * @brief Find the mapped region containing the offset.
+     * @param The memory offset.
+     * @return The region, or nullptr if the offset is unmapped.
+     */
+    const Vision::MemoryRegion* Vision::findRegion(u64 offset) const {
+        auto it = std::upper_bound(m_regions.begin(), m_regions.end(), offset, [](u64 value, const MemoryRegion& region) { return value < region.addr; });
+        if (it == m_regions.begin()) {
+            return nullptr;
+        }
+
+        --it;
+        return offset - it->addr < it->size ? &*it : nullptr;
+    }
+
+    /**
+     * @brief Check that a range is covered by consecutive mapped regions.
+     * @param The memory offset.
+     * @param The number of bytes.
+     * @param If true, every region must be readable.
+     * @return true if covered, false otherwise.
+     */
+    bool Vision::rangeInRegions(u64 offset, u64 size, bool requireRead) const {
+        if (size == 0) {
+            return true;
+        }
+
+        u64 end = offset + size;
+        if (end < offset) {
+            return false;
+        }
+
+        while (offset < end) {
+            const MemoryRegion* region = findRegion(offset);
+            if (!region || (requireRead && !(region->perm & Perm_R))) {
+                return false;
+            }
+
+            offset = region->addr + region->size;
+        }
+
+        return true;
+    }
+
     /**
      * @brief Read memory from the debugged process.
      * @param Buffer to store the read data.
@@ -123,7 +600,11 @@ namespace MemoryCommands {
      * @param Offset into the buffer for multi-read (default 0).
      */
     Result Vision::readMem(const std::vector<char>& buffer, u64 offset, u64 size, u64 multi) {
-        attach();
+        if (!attach()) {
+            return MAKERESULT(Module_Kernel, KernelError_InvalidHandle);
+        }
+
+        ++m_kernelReadCount;
         Result rc = svcReadDebugProcessMemory((void*)(buffer.data() + multi), m_debugHandle, offset, size);
         detach();
         return rc;
@@ -136,7 +617,11 @@ namespace MemoryCommands {
      * @param Buffer containing data to write.
      */
     void Vision::writeMem(u64 offset, u64 size, const std::vector<char>& buffer) {
-        attach();
+        if (!attach()) {
+            Logger::instance().log("writeMem() attach() failed. Offset=" + std::to_string(offset) + ", Size=" + std::to_string(size));
+            return;
+        }
+
         Result rc = svcWriteDebugProcessMemory(m_debugHandle, (void*)buffer.data(), offset, size);
         if (R_FAILED(rc)) {
             Logger::instance().log("writeMem() svcWriteDebugProcessMemory() failed. Offset=" + std::to_string(offset) + ", Size=" + std::to_string(size), std::to_string(R_DESCRIPTION(rc)));
@@ -11,35 +11,90 @@ namespace ModuleBase {
 
     /**
      * @brief Attach to the current application process for debugging.
+     * Reuses the open handle while a debug session is active, and reattaches if the application PID has changed.
      * @return true if attach succeeded, false otherwise.
      */
     bool BaseCommands::attach() {
+        if (m_debugHandle != 0) {
+            if (m_debugPid == m_metaData.pid) {
+                return true;
+            }
+
+            Logger::instance().log("attach() application PID changed, reattaching: pid=" + std::to_string(m_metaData.pid));
+            closeDebugHandle();
+        }
+
         Result rc = svcDebugActiveProcess(&m_debugHandle, m_metaData.pid);
         if (R_FAILED(rc)) {
             Logger::instance().log("attach() svcDebugActiveProcess() failed: pid=" + std::to_string(m_metaData.pid), std::to_string(R_DESCRIPTION(rc)));
-            detach();
+            m_debugHandle = 0;
+            m_debugPid = 0;
             return false;
         }
 
+        m_debugPid = m_metaData.pid;
         return true;
     }
 
     /**
-     * @brief Detach from the debugged process.
+     * @brief Detach from the debugged process. The handle is kept open while a debug session is active.
      */
     void BaseCommands::detach() {
+        if (m_debugSessionDepth == 0) {
+            closeDebugHandle();
+        }
+    }
+
+    /**
+     * @brief Begin a debug session. The process is attached lazily on the first read or write.
+     */
+    void BaseCommands::beginDebugSession() {
+        ++m_debugSessionDepth;
+    }
+
+    /**
+     * @brief End a debug session, closing the debug handle once the outermost session ends.
+     */
+    void BaseCommands::endDebugSession() {
+        if (m_debugSessionDepth == 0) {
+            return;
+        }
+
+        if (--m_debugSessionDepth == 0) {
+            closeDebugHandle();
+        }
+    }
+
+    /**
+     * @brief Let the game run again partway through a long operation. The next read or write reattaches.
+     * A client that holds a session with debugSessionBegin asked for the game to stay paused, so the handle is kept for it.
+     */
+    void BaseCommands::yieldDebugHandle() {
+        if (m_clientDebugSessions == 0) {
+            closeDebugHandle();
+        }
+    }
+
+    /**
+     * @brief Close the debug handle if one is open.
+     */
+    void BaseCommands::closeDebugHandle() {
         if (m_debugHandle != 0) {
             svcCloseHandle(m_debugHandle);
+            m_debugHandle = 0;
         }
+
+        m_debugPid = 0;
     }
 
     /**
      * @brief Initialize metadata for the current process.
+     * @return true if the process was attached and its module bases were read, false otherwise.
      */
-    void BaseCommands::initMetaData() {
+    bool BaseCommands::initMetaData() {
         if (!attach()) {
             Logger::instance().log("initMetaData() attach() failed.");
-            return;
+            return false;
         }
 
         m_metaData.main_nso_base = getMainNsoBase();
@@ -53,6 +108,53 @@ namespace ModuleBase {
         }
 
         detach();
+        return m_metaData.main_nso_base != 0 && m_metaData.heap_base != 0;
+    }
+
+    /**
+     * @brief Refresh metadata only when the application process has changed since the last successful refresh.
+     * @param The current application PID.
+     */
+    void BaseCommands::updateMetaData(u64 pid) {
+        if (m_metaDataValid && m_metaData.pid == pid) {
+            ++m_metaCacheHits;
+            return;
+        }
+
+        ++m_metaCacheMisses;
+        m_metaData.pid = pid;
+        m_metaDataValid = initMetaData();
+    }
+
+    /**
+     * @brief Force the next updateMetaData() call to refresh metadata.
+     */
+    void BaseCommands::invalidateMetaData() {
+        m_metaDataValid = false;
+    }
+
+    /**
+     * @brief Build an unsolicited message for the client, framed as an Event when the binary protocol is in use.
+     * @param The text message, including its line terminator.
+     * @return The bytes to queue for sending.
+     */
+    std::vector<char> BaseCommands::makeEventMessage(const std::string& message) {
+        std::shared_ptr<ClientSettings> events = m_eventSettings.load();
+        return makeEventMessage(message, events ? *events : m_defaultSettings);
+    }
+
+    /**
+     * @brief Build an unsolicited message for a particular client, framed as an Event when that client uses the binary protocol.
+     * @param The text message, including its line terminator.
+     * @param The client's settings.
+     * @return The bytes to queue for sending.
+     */
+    std::vector<char> BaseCommands::makeEventMessage(const std::string& message, const ClientSettings& client) {
+        if (client.protocolVersion == Protocol::BinaryVersion) {
+            return Protocol::Frame::make(Protocol::Opcode::Event, Protocol::Flags::None, 0, message.data(), message.size());
+        }
+
+        return std::vector<char>(message.begin(), message.end());
     }
 
     /**
@@ -221,11 +323,54 @@ namespace ModuleBase {
         return !(pid == 0 || R_FAILED(rc));
     }
 
+    /**
+     * @brief Look up a "configure" setting.
+     * @param The setting name.
+     * @return The setter, or nullptr if there is no such setting.
+     */
+    const BaseCommands::ConfigureFunc* BaseCommands::findConfigure(std::string_view name) {
+        static constexpr auto table = Dispatch::makeTable<std::string_view, ConfigureFunc>({
+            REGISTER_CFG_CMD("buttonClickSleepTime", setButtonClickSleepTime),
+            REGISTER_CFG_CMD("keySleepTime", setKeySleepTime),
+            REGISTER_CFG_CMD("fingerDiameter", setFingerDiameter),
+            REGISTER_CFG_CMD("pollRate", setPollRate),
+            REGISTER_CFG_CMD("enablePA", setEnabledPA),
+            REGISTER_CFG_CMD("enableLogs", setEnabledLogs),
+            REGISTER_CFG_CMD("enableBackwardsCompat", setEnabledBackwards),
+            REGISTER_CFG_CMD("peekGapThreshold", setPeekGapThreshold),
+            REGISTER_CFG_CMD("pointerCache", setPointerCache),
+            REGISTER_CFG_CMD("pointerCacheTtl", setPointerCacheTtl),
+            REGISTER_CFG_CMD("compression", setCompression),
+            REGISTER_CFG_CMD("compressionThreshold", setCompressionThreshold),
+            REGISTER_CFG_CMD("sendBatch", setSendBatch),
+            REGISTER_CFG_CMD("sendLinger", setSendLinger)
+        });
+
+        return table.find(name);
+    }
+
+    /**
+     * @brief Look up a "game" subcommand.
+     * @param The subcommand name.
+     * @return The handler, or nullptr if there is no such subcommand.
+     */
+    const BaseCommands::GameFunc* BaseCommands::findGame(std::string_view name) {
+        static constexpr auto table = Dispatch::makeTable<std::string_view, GameFunc>({
+            REGISTER_GAME_CMD("icon", getGameIcon),
+            REGISTER_GAME_CMD("version", getGameVersion),
+            REGISTER_GAME_CMD("rating", getGameRating),
+            REGISTER_GAME_CMD("author", getGameAuthor),
+            REGISTER_GAME_CMD("name", getGameName)
+        });
+
+        return table.find(name);
+    }
+
     /**
      * @brief Set the button click sleep time from parameters.
      * @param The parameters vector.
      */
-    void BaseCommands::setButtonClickSleepTime(const std::vector<std::string>& params) {
+    void BaseCommands::setButtonClickSleepTime(Args params) {
         if (params.size() < 2) {
             Logger::instance().log("setKeySleepTime() params size is less than 2.");
             return;
@@ -238,7 +383,7 @@ namespace ModuleBase {
      * @brief Set the key press sleep time from parameters.
      * @param The parameters vector.
      */
-    void BaseCommands::setKeySleepTime(const std::vector<std::string>& params) {
+    void BaseCommands::setKeySleepTime(Args params) {
         if (params.size() < 2) {
             Logger::instance().log("setKeySleepTime() params size is less than 2.");
             return;
@@ -251,7 +396,7 @@ namespace ModuleBase {
      * @brief Set the finger diameter from parameters.
      * @param The parameters vector.
      */
-    void BaseCommands::setFingerDiameter(const std::vector<std::string>& params) {
+    void BaseCommands::setFingerDiameter(Args params) {
         if (params.size() < 2) {
             Logger::instance().log("setFingerDiameter() params size is less than 2.");
             return;
@@ -264,7 +409,7 @@ namespace ModuleBase {
      * @brief Set the poll rate from parameters.
      * @param The parameters vector.
      */
-    void BaseCommands::setPollRate(const std::vector<std::string>& params) {
+    void BaseCommands::setPollRate(Args params) {
         if (params.size() < 2) {
             Logger::instance().log("setPollRate() params size is less than 2.");
             return;
@@ -273,11 +418,102 @@ namespace ModuleBase {
         m_pollRate = Utils::parseStringToInt(params[1]);
     }
 
+    /**
+     * @brief Set the largest gap, in bytes, bridged when merging multi-peek ranges into one read.
+     * @param The parameters vector.
+     */
+    void BaseCommands::setPeekGapThreshold(Args params) {
+        if (params.size() < 2) {
+            Logger::instance().log("setPeekGapThreshold() params size is less than 2.");
+            return;
+        }
+
+        m_peekGapThreshold = Utils::parseStringToInt(params[1]);
+    }
+
+    /**
+     * @brief Set whether resolved pointer chains are cached from parameters.
+     * @param The parameters vector.
+     */
+    void BaseCommands::setPointerCache(Args params) {
+        if (params.size() < 2) {
+            Logger::instance().log("setPointerCache() params size is less than 2.");
+            return;
+        }
+
+        m_pointerCacheEnabled = (bool)Utils::parseStringToInt(params[1]);
+    }
+
+    /**
+     * @brief Set how long, in milliseconds, a cached pointer chain is trusted before it is walked again.
+     * @param The parameters vector.
+     */
+    void BaseCommands::setPointerCacheTtl(Args params) {
+        if (params.size() < 2) {
+            Logger::instance().log("setPointerCacheTtl() params size is less than 2.");
+            return;
+        }
+
+        m_pointerCacheTtl = Utils::parseStringToInt(params[1]);
+    }
+
+    /**
+     * @brief Set whether responses at or above the compression threshold are sent LZ4-compressed. Reset when the client disconnects.
+     * @param The parameters vector.
+     */
+    void BaseCommands::setCompression(Args params) {
+        if (params.size() < 2) {
+            Logger::instance().log("setCompression() params size is less than 2.");
+            return;
+        }
+
+        clientSettings().compressionEnabled = (bool)Utils::parseStringToInt(params[1]);
+    }
+
+    /**
+     * @brief Set the smallest response, in bytes, that is compressed.
+     * @param The parameters vector.
+     */
+    void BaseCommands::setCompressionThreshold(Args params) {
+        if (params.size() < 2) {
+            Logger::instance().log("setCompressionThreshold() params size is less than 2.");
+            return;
+        }
+
+        clientSettings().compressionThreshold = Utils::parseStringToInt(params[1]);
+    }
+
+    /**
+     * @brief Set the most bytes of queued replies the sender coalesces into one write. 0 sends every reply separately.
+     * @param The parameters vector.
+     */
+    void BaseCommands::setSendBatch(Args params) {
+        if (params.size() < 2) {
+            Logger::instance().log("setSendBatch() params size is less than 2.");
+            return;
+        }
+
+        clientSettings().sendBatchBytes = Utils::parseStringToInt(params[1]);
+    }
+
+    /**
+     * @brief Set how many microseconds a lone reply waits for more to batch with. Trades latency for fewer sends.
+     * @param The parameters vector.
+     */
+    void BaseCommands::setSendLinger(Args params) {
+        if (params.size() < 2) {
+            Logger::instance().log("setSendLinger() params size is less than 2.");
+            return;
+        }
+
+        clientSettings().sendLingerUs = Utils::parseStringToInt(params[1]);
+    }
+
     /**
      * @brief Set whether PA is enabled from parameters.
      * @param The parameters vector.
      */
-    void BaseCommands::setEnabledPA(const std::vector<std::string>& params) {
+    void BaseCommands::setEnabledPA(Args params) {
         if (params.size() < 2) {
             Logger::instance().log("setEnabledPA() params size is less than 2.");
             return;
@@ -290,7 +526,7 @@ namespace ModuleBase {
      * @brief Set whether logs are enabled from parameters.
      * @param The parameters vector.
      */
-    void BaseCommands::setEnabledLogs(const std::vector<std::string>& params) {
+    void BaseCommands::setEnabledLogs(Args params) {
         if (params.size() < 2) {
             Logger::instance().log("setEnabledLogs() params size is less than 2.");
             return;
@@ -304,7 +540,7 @@ namespace ModuleBase {
      * @brief Set whether backwards compatibility is enabled from parameters.
      * @param The parameters vector.
      */
-    void BaseCommands::setEnabledBackwards(const std::vector<std::string>& params) {
+    void BaseCommands::setEnabledBackwards(Args params) {
         if (params.size() < 2) {
             Logger::instance().log("setEnabledBackwards() params size is less than 2.");
             return;
@@ -471,21 +707,26 @@ namespace ModuleBase {
      * @param Parameters containing the time value.
      * @param[out] Output buffer indicating success.
      */
-    void BaseCommands::setSwitchTime(const std::vector<std::string>& params, std::vector<char>& buffer) {
+    void BaseCommands::setSwitchTime(Args params, std::vector<char>& buffer) {
         bool success = false;
         buffer.resize(sizeof(success));
 
-        time_t input = (time_t)std::stoull(params[0], NULL, 10);
-        std::tm* toSet = localtime(&input);
-        if (toSet->tm_year >= 100 || toSet->tm_year <= 160) { // >= 2000 || <= 2060
-            Result rc = timeSetCurrentTime(TimeType_NetworkSystemClock, input);
-            if (R_SUCCEEDED(rc)) {
-                success = true;
+        u64 seconds = 0;
+        if (!Utils::parseInt(params[0], seconds)) {
+            Logger::instance().log("setSwitchTime() invalid time (" + std::string(params[0]) + ").");
+        } else {
+            time_t input = (time_t)seconds;
+            std::tm* toSet = localtime(&input);
+            if (toSet->tm_year >= 100 || toSet->tm_year <= 160) { // >= 2000 || <= 2060
+                Result rc = timeSetCurrentTime(TimeType_NetworkSystemClock, input);
+                if (R_SUCCEEDED(rc)) {
+                    success = true;
+                } else {
+                    Logger::instance().log("setSwitchTime() timeSetCurrentTime() failed.", std::to_string(R_DESCRIPTION(rc)));
+                }
             } else {
-                Logger::instance().log("setSwitchTime() timeSetCurrentTime() failed.", std::to_string(R_DESCRIPTION(rc)));
+                Logger::instance().log("setSwitchTime() invalid time range.");
             }
-        } else {
-            Logger::instance().log("setSwitchTime() invalid time range.");
         }
 
         std::copy(reinterpret_cast<const char*>(&success),
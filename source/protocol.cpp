@@ -0,0 +1,78 @@
+#include "defines.h"
+#include "protocol.h"
+#include "logger.h"
+
+namespace Protocol {
+    using namespace SbbLog;
+
+    /**
+     * @brief Build a complete frame.
+     * @param The opcode.
+     * @param Frame flags.
+     * @param The request id.
+     * @param The payload.
+     * @param The payload size.
+     * @return The header followed by the payload.
+     */
+    std::vector<char> Frame::make(u16 opcode, u16 flags, u32 requestId, const char* payload, size_t size) {
+        std::vector<char> buffer;
+        buffer.reserve(sizeof(FrameHeader) + size);
+        writeHeader(buffer, opcode, flags, requestId, (u32)size);
+        buffer.insert(buffer.end(), payload, payload + size);
+        return buffer;
+    }
+
+    /**
+     * @brief Append a frame header to a buffer.
+     * @param[out] The buffer to append to.
+     * @param The opcode.
+     * @param Frame flags.
+     * @param The request id.
+     * @param The number of bytes that will follow the header.
+     */
+    void Frame::writeHeader(std::vector<char>& buffer, u16 opcode, u16 flags, u32 requestId, u32 length) {
+        FrameHeader header { length, opcode, flags, requestId };
+        const char* bytes = reinterpret_cast<const char*>(&header);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(header));
+    }
+
+    /**
+     * @brief Move the first complete frame out of a receive buffer.
+     * @param[in,out] Bytes received so far.
+     * @param[out] The extracted frame, header included.
+     * @return 1 if a frame was extracted, 0 if more data is needed, -1 if the header is invalid.
+     */
+    int Frame::extract(std::string& buffer, std::string& frame) {
+        size_t total = 0;
+        int rc = measure(buffer, total);
+        if (rc <= 0) {
+            return rc;
+        }
+
+        frame.assign(buffer, 0, total);
+        buffer.erase(0, total);
+        return 1;
+    }
+
+    /**
+     * @brief Find the size of the first complete frame in received bytes without copying it, so it can be handled in place.
+     * @param Bytes received so far.
+     * @param[out] The frame's size, header included.
+     * @return 1 if a complete frame is present, 0 if more data is needed, -1 if the header is invalid.
+     */
+    int Frame::measure(std::string_view buffer, size_t& size) {
+        if (buffer.size() < sizeof(FrameHeader)) {
+            return 0;
+        }
+
+        FrameHeader header;
+        std::memcpy(&header, buffer.data(), sizeof(header));
+        if (header.length > MaxFrameLength) {
+            Logger::instance().log("Frame::measure() frame too large: " + std::to_string(header.length));
+            return -1;
+        }
+
+        size = sizeof(header) + header.length;
+        return buffer.size() < size ? 0 : 1;
+    }
+}
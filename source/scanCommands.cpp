@@ -0,0 +1,507 @@
+#include "defines.h"
+#include "scanCommands.h"
+#include "util.h"
+#include "logger.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace ScanCommands {
+    using namespace SbbLog;
+    using namespace Util;
+
+    /**
+     * @brief Check whether any aligned value in a 16-byte block equals the value.
+     * @param Pointer to 16 bytes of data.
+     * @param The value to look for.
+     * @return true if the block may contain a match.
+     */
+    template<typename T>
+    static inline bool blockMayMatch(const char* ptr, T value) {
+#if defined(__ARM_NEON)
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(ptr));
+        uint8x16_t eq;
+        if constexpr (sizeof(T) == 1) {
+            eq = vceqq_u8(block, vdupq_n_u8(value));
+        } else if constexpr (sizeof(T) == 2) {
+            eq = vreinterpretq_u8_u16(vceqq_u16(vreinterpretq_u16_u8(block), vdupq_n_u16(value)));
+        } else if constexpr (sizeof(T) == 4) {
+            eq = vreinterpretq_u8_u32(vceqq_u32(vreinterpretq_u32_u8(block), vdupq_n_u32(value)));
+        } else {
+            eq = vreinterpretq_u8_u64(vceqq_u64(vreinterpretq_u64_u8(block), vdupq_n_u64(value)));
+        }
+
+        return vmaxvq_u8(eq) != 0;
+#else
+        for (size_t i = 0; i < 16; i += sizeof(T)) {
+            T current;
+            std::memcpy(&current, ptr + i, sizeof(T));
+            if (current == value) {
+                return true;
+            }
+        }
+
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Append the address of every aligned value in the data equal to the value, rejecting 16-byte blocks with vector compares.
+     * @param The data read from the process.
+     * @param The data size.
+     * @param The value to look for.
+     * @param The process address of the first byte of data.
+     * @param[out] Candidate addresses.
+     * @param[out] Candidate values.
+     * @param Maximum number of candidates.
+     * @return true if the candidate capacity was reached.
+     */
+    template<typename T>
+    static bool findAligned(const char* data, size_t size, T value, u64 address, std::vector<u64>& addresses, std::vector<u64>& values, size_t capacity) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            if (!blockMayMatch<T>(data + i, value)) {
+                continue;
+            }
+
+            for (size_t k = i; k < i + 16; k += sizeof(T)) {
+                T current;
+                std::memcpy(&current, data + k, sizeof(T));
+                if (current == value) {
+                    if (addresses.size() >= capacity) {
+                        return true;
+                    }
+
+                    addresses.push_back(address + k);
+                    values.push_back(current);
+                }
+            }
+        }
+
+        for (; i + sizeof(T) <= size; i += sizeof(T)) {
+            T current;
+            std::memcpy(&current, data + i, sizeof(T));
+            if (current == value) {
+                if (addresses.size() >= capacity) {
+                    return true;
+                }
+
+                addresses.push_back(address + i);
+                values.push_back(current);
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Start a new scan over the readable and writable regions of the application.
+     * The game is let run again after every ScanYieldSize bytes, so a large scan pauses it in short bursts rather than once for the whole scan.
+     * @param The value type.
+     * @param The value to search for, or a hex byte pattern for ScanType::Bytes.
+     * @param Lowest absolute address to scan.
+     * @param Address to stop scanning at.
+     * @param Output buffer for the candidate count.
+     */
+    void Scanner::scanStart(ScanType type, std::string_view value, u64 start, u64 end, std::vector<char>& buffer) {
+        DebugSession session(*this);
+        scanReset();
+        ScanState& state = getScanState();
+        state.type = type;
+        if (!parseScanValue(state, value, state.value, state.pattern)) {
+            Logger::instance().log("scanStart() failed to parse value (" + std::string(value) + ").");
+            writeScanCount(state, buffer);
+            return;
+        }
+
+        state.pid = m_metaData.pid;
+        u64 width = getScanWidth(state);
+        u64 overlap = state.type == ScanType::Bytes ? width - 1 : 0;
+        std::vector<char> chunk;
+        u64 sinceYield = 0;
+        for (const auto& region : getRegionMap(true)) {
+            if ((region.perm & Perm_Rw) != Perm_Rw) {
+                continue;
+            }
+
+            u64 begin = std::max(region.addr, start);
+            u64 finish = std::min(region.addr + region.size, end);
+            if (state.type != ScanType::Bytes) {
+                begin = (begin + width - 1) & ~(width - 1);
+            }
+
+            for (u64 addr = begin; addr < finish && !state.overflow; addr += ScanChunkSize) {
+                if (sinceYield >= ScanYieldSize) {
+                    yieldDebugHandle();
+                    sinceYield = 0;
+                }
+
+                u64 size = std::min(ScanChunkSize + overlap, finish - addr);
+                sinceYield += size;
+                chunk.resize(size);
+                Result rc = readMem(chunk, addr, size);
+                if (R_FAILED(rc)) {
+                    Logger::instance().log("scanStart() readMem() failed. Offset=" + std::to_string(addr) + ", Size=" + std::to_string(size), std::to_string(R_DESCRIPTION(rc)));
+                    continue;
+                }
+
+                scanChunk(state, chunk.data(), size, addr);
+            }
+
+            if (state.overflow) {
+                Logger::instance().log("scanStart() candidate capacity reached, narrow the search with a more specific value.");
+                break;
+            }
+        }
+
+        writeScanCount(state, buffer);
+    }
+
+    /**
+     * @brief Narrow the candidate set by re-reading every candidate and comparing it with its last value. Yields like scanStart().
+     * @param The comparison to keep candidates by.
+     * @param The value for ScanMode::Equals.
+     * @param Output buffer for the candidate count.
+     */
+    void Scanner::scanNext(ScanMode mode, std::string_view value, std::vector<char>& buffer) {
+        DebugSession session(*this);
+        ScanState& state = getScanState();
+        if (state.pid != m_metaData.pid) {
+            Logger::instance().log("scanNext() application process changed, resetting scan.");
+            scanReset();
+            writeScanCount(getScanState(), buffer);
+            return;
+        }
+
+        u64 target = state.value;
+        std::vector<char> pattern = state.pattern;
+        if (mode == ScanMode::Equals && !value.empty() && !parseScanValue(state, value, target, pattern)) {
+            Logger::instance().log("scanNext() failed to parse value (" + std::string(value) + ").");
+            writeScanCount(state, buffer);
+            return;
+        }
+
+        u64 width = getScanWidth(state);
+        if (state.type == ScanType::Bytes && (pattern.size() != width || mode == ScanMode::Increased || mode == ScanMode::Decreased)) {
+            Logger::instance().log("scanNext() unsupported comparison for a byte pattern scan.");
+            writeScanCount(state, buffer);
+            return;
+        }
+
+        getRegionMap();
+        std::vector<char> chunk;
+        u64 sinceYield = 0;
+        size_t kept = 0;
+        size_t count = state.addresses.size();
+        for (size_t i = 0; i < count;) {
+            if (sinceYield >= ScanYieldSize) {
+                yieldDebugHandle();
+                sinceYield = 0;
+            }
+
+            u64 spanStart = state.addresses[i];
+            u64 spanLimit = std::min(spanStart + ScanChunkSize, getRegionEnd(spanStart));
+            size_t j = i + 1;
+            while (j < count && state.addresses[j] + width <= spanLimit) {
+                ++j;
+            }
+
+            u64 spanSize = state.addresses[j - 1] + width - spanStart;
+            sinceYield += spanSize;
+            chunk.resize(spanSize);
+            Result rc = readMem(chunk, spanStart, spanSize);
+            if (R_SUCCEEDED(rc)) {
+                for (size_t k = i; k < j; ++k) {
+                    const char* ptr = chunk.data() + (state.addresses[k] - spanStart);
+                    u64 current = 0;
+                    std::memcpy(&current, ptr, std::min<u64>(width, sizeof(u64)));
+
+                    bool keep = state.type == ScanType::Bytes && mode == ScanMode::Equals
+                        ? std::memcmp(ptr, pattern.data(), width) == 0
+                        : compareScanValue(state, mode, current, state.values[k], target);
+                    if (keep) {
+                        state.addresses[kept] = state.addresses[k];
+                        state.values[kept] = current;
+                        ++kept;
+                    }
+                }
+            }
+
+            i = j;
+        }
+
+        state.addresses.resize(kept);
+        state.values.resize(kept);
+        writeScanCount(state, buffer);
+    }
+
+    /**
+     * @brief Write the candidate count followed by up to max "address:value" hex entries.
+     * @param Maximum number of candidates to return.
+     * @param Output buffer for result.
+     */
+    void Scanner::scanResults(u64 max, std::vector<char>& buffer) {
+        const ScanState& state = getScanState();
+        size_t count = std::min<size_t>(max, state.addresses.size());
+        std::string res = "count=" + std::to_string(state.addresses.size());
+        char entry[40];
+        for (size_t i = 0; i < count; ++i) {
+            int len = std::snprintf(entry, sizeof(entry), " %lX:%lX", state.addresses[i], state.values[i]);
+            res.append(entry, len);
+        }
+
+        res += "\r\n";
+        buffer.insert(buffer.begin(), res.begin(), res.end());
+    }
+
+    /**
+     * @brief Drop the current client's scan and its candidates.
+     */
+    void Scanner::scanReset() {
+        std::lock_guard<std::recursive_mutex> lock(m_debugMutex);
+        m_scans.erase(&clientSettings());
+    }
+
+    /**
+     * @brief Get the current client's scan, so clients scanning at the same time don't narrow each other's candidates.
+     * @return The scan state, created empty if the client has none.
+     */
+    Scanner::ScanState& Scanner::getScanState() {
+        return m_scans[&clientSettings()];
+    }
+
+    /**
+     * @brief Parse a scan type name (u8, u16, u32, u64, f32, f64, bytes).
+     * @param The string argument.
+     * @param[out] The scan type.
+     * @return true if parsed, false otherwise.
+     */
+    bool Scanner::parseScanType(std::string_view arg, ScanType& type) {
+        static const std::pair<const char*, ScanType> types[] = {
+            { "u8", ScanType::U8 }, { "u16", ScanType::U16 }, { "u32", ScanType::U32 }, { "u64", ScanType::U64 },
+            { "f32", ScanType::F32 }, { "f64", ScanType::F64 }, { "bytes", ScanType::Bytes },
+        };
+
+        for (const auto& [name, value] : types) {
+            if (arg == name) {
+                type = value;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Parse a scan comparison name (equals, changed, unchanged, increased, decreased).
+     * @param The string argument.
+     * @param[out] The scan mode.
+     * @return true if parsed, false otherwise.
+     */
+    bool Scanner::parseScanMode(std::string_view arg, ScanMode& mode) {
+        static const std::pair<const char*, ScanMode> modes[] = {
+            { "equals", ScanMode::Equals }, { "changed", ScanMode::Changed }, { "unchanged", ScanMode::Unchanged },
+            { "increased", ScanMode::Increased }, { "decreased", ScanMode::Decreased },
+        };
+
+        for (const auto& [name, value] : modes) {
+            if (arg == name) {
+                mode = value;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Parse a value of the scan's type into its raw bits, or a hex byte pattern for ScanType::Bytes.
+     * @param The scan.
+     * @param The string argument.
+     * @param[out] The raw value bits, truncated to the type width.
+     * @param[out] The byte pattern.
+     * @return true if parsed, false otherwise.
+     */
+    bool Scanner::parseScanValue(const ScanState& state, std::string_view arg, u64& value, std::vector<char>& pattern) {
+        switch (state.type) {
+        case ScanType::Bytes:
+            if (!Utils::parseByteBuffer(arg, pattern)) {
+                return false;
+            }
+
+            value = 0;
+            std::memcpy(&value, pattern.data(), std::min<size_t>(pattern.size(), sizeof(u64)));
+            return true;
+        case ScanType::F32: {
+            float f = 0;
+            if (std::from_chars(arg.data(), arg.data() + arg.size(), f).ec != std::errc()) {
+                return false;
+            }
+
+            u32 bits = 0;
+            std::memcpy(&bits, &f, sizeof(bits));
+            value = bits;
+            return true;
+        }
+        case ScanType::F64: {
+            double d = 0;
+            if (std::from_chars(arg.data(), arg.data() + arg.size(), d).ec != std::errc()) {
+                return false;
+            }
+
+            std::memcpy(&value, &d, sizeof(value));
+            return true;
+        }
+        default: {
+            // Negative values are stored two's complement, so "-1" matches an all-ones value of the scan's width.
+            s64 negative = 0;
+            if (!arg.empty() && arg[0] == '-') {
+                if (!Utils::parseSignedInt(arg, negative)) {
+                    return false;
+                }
+
+                value = (u64)negative;
+            } else if (!Utils::parseInt(arg, value)) {
+                return false;
+            }
+
+            u64 width = getScanWidth(state);
+            if (width < sizeof(u64)) {
+                value &= (1ULL << (width * 8)) - 1;
+            }
+
+            return true;
+        }
+        }
+    }
+
+    /**
+     * @brief Get the width in bytes of the scan value.
+     * @param The scan.
+     * @return The width.
+     */
+    u64 Scanner::getScanWidth(const ScanState& state) {
+        switch (state.type) {
+        case ScanType::U8: return 1;
+        case ScanType::U16: return 2;
+        case ScanType::U32: return 4;
+        case ScanType::F32: return 4;
+        case ScanType::Bytes: return state.pattern.size();
+        default: return 8;
+        }
+    }
+
+    /**
+     * @brief Compare a candidate's current value according to the scan mode and type.
+     * @param The scan.
+     * @param The scan mode.
+     * @param The current raw value.
+     * @param The raw value from the previous pass.
+     * @param The raw value for ScanMode::Equals.
+     * @return true if the candidate should be kept.
+     */
+    bool Scanner::compareScanValue(const ScanState& state, ScanMode mode, u64 current, u64 previous, u64 value) {
+        switch (mode) {
+        case ScanMode::Equals: return current == value;
+        case ScanMode::Changed: return current != previous;
+        case ScanMode::Unchanged: return current == previous;
+        default: break;
+        }
+
+        bool increased = false;
+        if (state.type == ScanType::F32) {
+            float cur, prev;
+            u32 curBits = (u32)current, prevBits = (u32)previous;
+            std::memcpy(&cur, &curBits, sizeof(cur));
+            std::memcpy(&prev, &prevBits, sizeof(prev));
+            if (cur == prev) {
+                return false;
+            }
+
+            increased = cur > prev;
+        } else if (state.type == ScanType::F64) {
+            double cur, prev;
+            std::memcpy(&cur, &current, sizeof(cur));
+            std::memcpy(&prev, &previous, sizeof(prev));
+            if (cur == prev) {
+                return false;
+            }
+
+            increased = cur > prev;
+        } else {
+            if (current == previous) {
+                return false;
+            }
+
+            increased = current > previous;
+        }
+
+        return mode == ScanMode::Increased ? increased : !increased;
+    }
+
+    /**
+     * @brief Collect matches from one chunk of process memory.
+     * @param The scan.
+     * @param The data read from the process.
+     * @param The data size, including the pattern overlap into the next chunk.
+     * @param The process address of the first byte of data.
+     */
+    void Scanner::scanChunk(ScanState& state, const char* data, size_t size, u64 address) {
+        switch (state.type) {
+        case ScanType::U8:
+            state.overflow = findAligned<u8>(data, size, (u8)state.value, address, state.addresses, state.values, ScanCandidateCapacity);
+            break;
+        case ScanType::U16:
+            state.overflow = findAligned<u16>(data, size, (u16)state.value, address, state.addresses, state.values, ScanCandidateCapacity);
+            break;
+        case ScanType::U32:
+        case ScanType::F32:
+            state.overflow = findAligned<u32>(data, size, (u32)state.value, address, state.addresses, state.values, ScanCandidateCapacity);
+            break;
+        case ScanType::U64:
+        case ScanType::F64:
+            state.overflow = findAligned<u64>(data, size, state.value, address, state.addresses, state.values, ScanCandidateCapacity);
+            break;
+        case ScanType::Bytes: {
+            // Only matches starting inside this chunk count, the overlap belongs to the next one.
+            size_t width = state.pattern.size();
+            size_t limit = std::min<size_t>(size, ScanChunkSize);
+            const char* ptr = data;
+            const char* last = data + limit;
+            while (ptr < last) {
+                ptr = (const char*)std::memchr(ptr, state.pattern[0], last - ptr);
+                if (!ptr) {
+                    break;
+                }
+
+                if ((size_t)(data + size - ptr) >= width && std::memcmp(ptr, state.pattern.data(), width) == 0) {
+                    if (state.addresses.size() >= ScanCandidateCapacity) {
+                        state.overflow = true;
+                        return;
+                    }
+
+                    state.addresses.push_back(address + (ptr - data));
+                    state.values.push_back(state.value);
+                }
+
+                ++ptr;
+            }
+            break;
+        }
+        }
+    }
+
+    /**
+     * @brief Write the candidate count, and whether the candidate capacity was reached.
+     * @param The scan.
+     * @param Output buffer for result.
+     */
+    void Scanner::writeScanCount(const ScanState& state, std::vector<char>& buffer) {
+        std::string res = "count=" + std::to_string(state.addresses.size()) + (state.overflow ? " overflow=1" : "") + "\r\n";
+        buffer.insert(buffer.begin(), res.begin(), res.end());
+    }
+}
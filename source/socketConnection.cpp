@@ -3,6 +3,9 @@
 #include "socketConnection.h"
 #include "commandHandler.h"
 #include "util.h"
+#include "bufferPool.h"
+#include "config.h"
+#include <algorithm>
 #include <cstring>
 #include <exception>
 #include <unistd.h>
@@ -12,6 +15,7 @@
 #include <sys/ioctl.h>
 #include <sys/select.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 
 namespace SocketConnection {
 	using namespace Util;
@@ -20,18 +24,19 @@ namespace SocketConnection {
 	using namespace ControllerCommands;
 
 	Result SocketConnection::initialize(Result& res) {
+		m_udpPort = Config::Settings::instance().snapshot()->udpPort;
 		const SocketInitConfig cfg = {
 			0x800, //tcp_tx_buf_size
 			0x40000, //tcp_rx_buf_size
 		    0x25000, //tcp_tx_buf_max_size
 			0x40000, //tcp_rx_buf_max_size
 
-		    0, //udp_tx_buf_size
-		    0, //udp_rx_buf_size
+		    m_udpPort != 0 ? 0x2400u : 0u, //udp_tx_buf_size, only with the UDP side channel on
+		    m_udpPort != 0 ? 0xA500u : 0u, //udp_rx_buf_size
 
 		    4, //sb_efficiency
 
-			1, //num_bsd_sessions
+			3, //num_bsd_sessions, so sends to one client don't wait on the select() watching the others
 			BsdServiceType::BsdServiceType_User,
 		};
 
@@ -98,20 +103,25 @@ namespace SocketConnection {
 			return -1;
 		}
 
+		if (m_udpPort != 0 && !m_udp.open(m_udpPort)) {
+			Logger::instance().log("UDP side channel unavailable, continuing with TCP only.");
+		}
+
 		//Logger::instance().log("Server socket created with FD: " + std::to_string(m_tcp.serverFd));
 		return 0;
 	}
 
 	void SocketConnection::closeSocket() {
-		if (m_tcp.clientFd != -1) {
-			close(m_tcp.clientFd);
-			m_tcp.clientFd = -1;
+		for (auto& client : getClients()) {
+			closeClient(client);
 		}
 
 		if (m_tcp.serverFd != -1) {
 			close(m_tcp.serverFd);
 			m_tcp.serverFd = -1;
 		}
+
+		m_udp.close();
     }
 
 	bool SocketConnection::connect() {
@@ -146,8 +156,9 @@ namespace SocketConnection {
 				}
 
 				if (FD_ISSET(m_tcp.serverFd, &readfds)) {
-					m_tcp.clientFd = accept(m_tcp.serverFd, (struct sockaddr*)&clientAddr, &clientSize);
-					if (m_tcp.clientFd >= 0) {
+					int clientFd = accept(m_tcp.serverFd, (struct sockaddr*)&clientAddr, &clientSize);
+					if (clientFd >= 0) {
+						addClient(clientFd);
 						break;
 					}
 
@@ -187,10 +198,136 @@ namespace SocketConnection {
 			return false;
         }
 
-		Logger::instance().log("Client connected. ClientFd: " + std::to_string(m_tcp.clientFd));
 		return true;
 	}
 
+	/**
+	 * @brief Register an accepted socket as a new client with default settings.
+	 * @param The client's socket.
+	 */
+	void SocketConnection::addClient(int fd) {
+		// Replies are small and written whole, so don't hold them back waiting to coalesce with the next one.
+		int opt = 1;
+		if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)) < 0) {
+			Logger::instance().log("setsockopt(TCP_NODELAY) error.", std::to_string(errno));
+		}
+
+		auto client = std::make_shared<Client>();
+		client->fd = fd;
+
+		std::lock_guard<std::mutex> lock(m_clientsMutex);
+		client->id = m_nextClientId++;
+		m_clients.push_back(client);
+		Logger::instance().log("Client " + std::to_string(client->id) + " connected. ClientFd: " + std::to_string(fd));
+	}
+
+	/**
+	 * @brief Accept a pending connection while already serving clients, refusing it past MaxClients.
+	 */
+	void SocketConnection::acceptClient() {
+		struct sockaddr_in clientAddr {};
+		socklen_t clientSize = sizeof(clientAddr);
+		int clientFd = accept(m_tcp.serverFd, (struct sockaddr*)&clientAddr, &clientSize);
+		if (clientFd < 0) {
+			if (errno != EWOULDBLOCK && errno != EAGAIN) {
+				Logger::instance().log("accept() error.", std::string(strerror(errno)));
+			}
+
+			return;
+		}
+
+		if (getClients().size() >= MaxClients) {
+			Logger::instance().log("Too many clients, refusing connection.");
+			close(clientFd);
+			return;
+		}
+
+		addClient(clientFd);
+	}
+
+	/**
+	 * @brief Close a client's socket, end its debug session, drop its watches and forget it. Controller queue replies move to the oldest remaining client if it was receiving them.
+	 * @param The client.
+	 */
+	void SocketConnection::closeClient(const std::shared_ptr<Client>& client) {
+		{
+			std::lock_guard<std::mutex> lock(m_clientsMutex);
+			std::erase(m_clients, client);
+		}
+
+		{
+			// Held so the sender thread can't write to the descriptor after it is closed and reused.
+			std::lock_guard<std::mutex> lock(client->sendMutex);
+			client->closed = true;
+			if (client->fd != -1) {
+				close(client->fd);
+				client->fd = -1;
+			}
+		}
+
+		client->sendQueue.clear();
+		ModuleBase::ClientScope scope(*client->settings);
+		m_handler->closeClientSession();
+		Logger::instance().log("Client " + std::to_string(client->id) + " disconnected.");
+		if (m_eventClient == client->id) {
+			std::shared_ptr<Client> next = getEventClient();
+			m_eventClient = next ? next->id : 0;
+			m_handler->setEventClient(next ? next->settings : nullptr);
+		}
+	}
+
+	/**
+	 * @brief Look up a connected client.
+	 * @param The client id.
+	 * @return The client, or nullptr if it has disconnected.
+	 */
+	std::shared_ptr<SocketConnection::Client> SocketConnection::findClient(u32 id) {
+		std::lock_guard<std::mutex> lock(m_clientsMutex);
+		for (auto& client : m_clients) {
+			if (client->id == id) {
+				return client;
+			}
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 * @brief The client that receives controller queue replies: the one that started the controller thread, else the oldest.
+	 * @return The client, or nullptr if none are connected.
+	 */
+	std::shared_ptr<SocketConnection::Client> SocketConnection::getEventClient() {
+		std::lock_guard<std::mutex> lock(m_clientsMutex);
+		for (auto& client : m_clients) {
+			if (client->id == m_eventClient) {
+				return client;
+			}
+		}
+
+		return m_clients.empty() ? nullptr : m_clients.front();
+	}
+
+	/**
+	 * @brief Snapshot the connected clients, so callers can iterate without holding the lock.
+	 * @return The clients, oldest first.
+	 */
+	std::vector<std::shared_ptr<SocketConnection::Client>> SocketConnection::getClients() {
+		std::lock_guard<std::mutex> lock(m_clientsMutex);
+		return m_clients;
+	}
+
+	/**
+	 * @brief Whether the sender thread has anything left to send.
+	 */
+	bool SocketConnection::hasPendingSends() {
+		if (!m_senderQueue.empty()) {
+			return true;
+		}
+
+		std::lock_guard<std::mutex> lock(m_clientsMutex);
+		return std::any_of(m_clients.begin(), m_clients.end(), [](const auto& client) { return !client->sendQueue.empty(); });
+	}
+
 	void SocketConnection::initializeThreads() {
 		if (getThreadsInitialized()) {
 			return;
@@ -205,16 +342,43 @@ namespace SocketConnection {
 				while (!m_stop) {
 					try {
 						std::vector<char> buffer;
-						while (m_senderQueue.pop(buffer) && !m_error) {
-							if (sendData(buffer.data(), buffer.size(), m_tcp.clientFd) <= 0) {
-								Logger::instance().log("sendData() failed or client disconnected.");
-								m_senderQueue.clear();
-								break;
+						auto wake = std::chrono::steady_clock::time_point::max();
+						bool sent = true;
+						while (sent && !m_error) {
+							sent = false;
+							// Unsolicited messages join the event client's replies, so a burst of them shares writes too.
+							while (!m_error && m_senderQueue.pop(buffer)) {
+								std::shared_ptr<Client> client = getEventClient();
+								if (client && !client->sendQueue.push(std::move(buffer))) {
+									m_sendStats.responses++;
+									sendToClient(*client, buffer);
+								}
+
+								BufferPool::Pool::instance().release(std::move(buffer));
+								sent = true;
+							}
+
+							// One batch per client per pass, so a long streamed response can't hold up the others.
+							wake = std::chrono::steady_clock::time_point::max();
+							for (auto& client : getClients()) {
+								if (!m_error && sendBatch(*client, wake)) {
+									sent = true;
+								}
+							}
+
+							if (sent) {
+								m_senderCv.notify_all();
 							}
 						}
 
+						// A lingering reply is sent when its deadline passes, or sooner if another reply joins it.
 						std::unique_lock<std::mutex> lock(m_senderMutex);
-						m_senderCv.wait(lock, [&]() { return !m_senderQueue.empty() || m_error || m_stop; });
+						auto ready = [&]() { return hasPendingSends() || m_error || m_stop; };
+						if (wake == std::chrono::steady_clock::time_point::max()) {
+							m_senderCv.wait(lock, ready);
+						} else {
+							m_senderCv.wait_until(lock, wake, ready);
+						}
 						if (m_error || m_stop) {
 							m_senderQueue.clear();
 						}
@@ -234,29 +398,61 @@ namespace SocketConnection {
 			m_commandThread = std::thread([&]() {
                 Logger::instance().log("Command thread starting...");
                 m_commandInitialized = true;
+				std::vector<std::string_view> tokens;
 				while (!m_stop) {
 					try {
 						std::string command;
-						while (m_commandQueue.pop(command) && !m_error) {
-							Utils::parseArgs(command, [&](const std::string& x, const std::vector<std::string>& y) {
-								auto buffer = m_handler->HandleCommand(x, y);
-								if (!m_handler->getIsRunningPA() && m_handler->getIsEnabledPA()) {
-									m_handler->startControllerThread(m_senderQueue, m_senderCv, m_stop, m_error);
+						Priority priority;
+						u32 clientId;
+						while (m_commandQueue.pop(command, priority, clientId) && !m_error) {
+							std::shared_ptr<Client> client = findClient(clientId);
+							if (!client) {
+								continue; // Disconnected before its command ran.
+							}
+
+							ModuleBase::ClientScope scope(*client->settings);
+							m_streamClient = clientId;
+
+							// Urgent commands skip the lane barrier, but still run after whatever this thread is doing now: an untagged command, a barrier or a push to a full lane.
+							bool urgent = priority == Priority::Urgent;
+							if (m_handler->isBinaryProtocol()) {
+								Lane lane = Handler::getFrameLane(command);
+								if (!urgent && lane != Lane::Barrier) {
+									m_lanes.push(lane, CommandLanes::Request { "", std::move(command), true, clientId });
+									continue;
+								}
+
+								if (!urgent) {
+									m_lanes.barrier();
 								}
 
+								auto buffer = m_handler->HandleFrame(command);
+								startHandlerThreads(clientId);
 								if (!buffer.empty()) {
-									if (buffer.back() != '\n') {
-										buffer.push_back('\n');
-									}
-
-									Logger::instance().log("Command processed: " + x + ".");
-									if (m_senderQueue.full()) {
-										Logger::instance().log("Sender queue full, dropping response.");
-										return;
-									}
-
-									m_senderQueue.push(std::move(buffer));
-									m_senderCv.notify_one();
+									queueFrame(std::move(buffer), clientId);
+								}
+
+								continue;
+							}
+
+							std::string requestId = Utils::takeRequestId(command);
+							Utils::parseArgs(command, tokens, [&](std::string_view x, Args y) {
+								// Untagged bulk commands keep strict ordering: every lane drains before they run.
+								Lane lane = requestId.empty() ? Lane::Barrier : Handler::getLane(x);
+								if (!urgent && lane != Lane::Barrier) {
+									m_lanes.push(lane, CommandLanes::Request { requestId, std::move(command), false, clientId });
+									return;
+								}
+
+								if (!urgent) {
+									m_lanes.barrier();
+								}
+
+								auto buffer = m_handler->HandleCommand(x, y);
+								startHandlerThreads(clientId);
+								if (!buffer.empty() || !requestId.empty()) {
+									Logger::instance().log("Command processed: " + std::string(x) + ".");
+									queueResponse(std::move(buffer), requestId, clientId);
 								}
 							});
 						}
@@ -275,9 +471,12 @@ namespace SocketConnection {
 					}
 				}
 
+				m_handler->endClientSession();
 				Logger::instance().log("Command thread exiting.");
 				stopThreads();
 			});
+
+			m_lanes.start([this](CommandLanes::Request& request, std::vector<std::string_view>& tokens) { runLaneRequest(request, tokens); });
 		} catch (const std::exception& e) {
 			Logger::instance().log("Exception while starting threads: ", e.what());
             stopThreads();
@@ -287,6 +486,195 @@ namespace SocketConnection {
         }
     }
 
+	/**
+	 * @brief Terminate and compress a text response, tag it, then queue it for the sender thread.
+	 * The "#id " prefix goes in front of any compression header, so a pipelining client can match the reply before decompressing it.
+	 * @param The response. Empty for a tagged command that returned nothing; it is still answered with the bare prefix.
+	 * @param The request id to echo as a "#id " prefix, or empty.
+	 * @param The id of the client to reply to.
+	 */
+	void SocketConnection::queueResponse(std::vector<char>&& buffer, const std::string& requestId, u32 client) {
+		if (buffer.empty() || buffer.back() != '\n') {
+			buffer.push_back('\n');
+		}
+
+		m_handler->compressResponse(buffer);
+		if (!requestId.empty()) {
+			std::string prefix = "#" + requestId + " ";
+			buffer.insert(buffer.begin(), prefix.begin(), prefix.end());
+		}
+
+		queueFrame(std::move(buffer), client);
+	}
+
+	/**
+	 * @brief Queue a finished response for the sender thread as-is.
+	 * @param The response.
+	 * @param The id of the client to reply to.
+	 */
+	void SocketConnection::queueFrame(std::vector<char>&& buffer, u32 client) {
+		if (buffer.empty()) {
+			return;
+		}
+
+		std::shared_ptr<Client> target = findClient(client);
+		if (!target || target->closed) {
+			return;
+		}
+
+		if (target->sendQueue.full()) {
+			Logger::instance().log("Send queue full, dropping response.");
+			return;
+		}
+
+		target->sendQueue.push(std::move(buffer));
+		m_senderCv.notify_all();
+	}
+
+	/**
+	 * @brief Queue an unsolicited message for the client with the given settings, such as an event from one of its watches.
+	 * @param The client's settings.
+	 * @param The message.
+	 * @return false if the client has disconnected or its send queue is full.
+	 */
+	bool SocketConnection::queueEvent(const ModuleBase::ClientSettings& settings, std::vector<char>&& message) {
+		std::shared_ptr<Client> target;
+		{
+			std::lock_guard<std::mutex> lock(m_clientsMutex);
+			auto it = std::find_if(m_clients.begin(), m_clients.end(), [&](const auto& client) { return client->settings.get() == &settings; });
+			if (it != m_clients.end()) {
+				target = *it;
+			}
+		}
+
+		if (!target || target->closed || !target->sendQueue.push(std::move(message))) {
+			return false;
+		}
+
+		m_senderCv.notify_all();
+		return true;
+	}
+
+	/**
+	 * @brief Queue a received command or frame for the command thread. Urgent and bulk commands have separate queues, so an urgent one is popped ahead of the bulk backlog.
+	 * @param The command line or frame.
+	 * @param Its priority.
+	 * @param The id of the client that sent it.
+	 */
+	void SocketConnection::queueCommand(std::string&& command, Priority priority, u32 client) {
+		if (!m_commandQueue.push(priority, std::move(command), client)) {
+			Logger::instance().log(priority == Priority::Urgent ? "Urgent command queue full, dropping command." : "Bulk command queue full, dropping command.");
+			return;
+		}
+
+		m_commandCv.notify_one();
+	}
+
+	/**
+	 * @brief Run a tagged request on its lane worker and queue the reply. Streaming is off, so a large peek can't interleave with other lanes.
+	 * A request that throws is answered with an error reply ("#id error", or an error frame) and the lane carries on.
+	 * @param The request.
+	 * @param Scratch storage for the lane's tokens.
+	 */
+	void SocketConnection::runLaneRequest(CommandLanes::Request& request, std::vector<std::string_view>& tokens) {
+		std::shared_ptr<Client> client = findClient(request.client);
+		if (!client) {
+			return;
+		}
+
+		ModuleBase::ClientScope scope(*client->settings);
+		try {
+			handleLaneRequest(request, tokens);
+		} catch (const std::exception& e) {
+			Logger::instance().log("Lane request exception: ", e.what());
+			queueLaneError(request);
+		}
+	}
+
+	void SocketConnection::handleLaneRequest(CommandLanes::Request& request, std::vector<std::string_view>& tokens) {
+		if (request.frame) {
+			queueFrame(m_handler->HandleFrame(request.command, false), request.client);
+			startHandlerThreads(request.client);
+			return;
+		}
+
+		Utils::parseArgs(request.command, tokens, [&](std::string_view x, Args y) {
+			auto buffer = m_handler->HandleCommand(x, y, false);
+			startHandlerThreads(request.client);
+			if (!buffer.empty() || !request.requestId.empty()) {
+				Logger::instance().log("Lane command processed: " + std::string(x) + ".");
+				queueResponse(std::move(buffer), request.requestId, request.client);
+			}
+		});
+	}
+
+	/**
+	 * @brief Answer a lane request that failed, so the client isn't left waiting on its request id.
+	 * @param The request.
+	 */
+	void SocketConnection::queueLaneError(const CommandLanes::Request& request) {
+		if (request.frame) {
+			Protocol::FrameHeader header;
+			std::memcpy(&header, request.command.data(), sizeof(header));
+			queueFrame(Protocol::Frame::make(header.opcode, Protocol::Flags::Error, header.requestId, nullptr, 0), request.client);
+			return;
+		}
+
+		static constexpr std::string_view error = "error";
+		queueResponse(std::vector<char>(error.begin(), error.end()), request.requestId, request.client);
+	}
+
+	/**
+	 * @brief Start the PA controller and watch threads once the last command enabled them. Their messages go to the client that started them.
+	 * @param The id of the client that sent the last command.
+	 */
+	void SocketConnection::startHandlerThreads(u32 client) {
+		bool startController = !m_handler->getIsRunningPA() && m_handler->getIsEnabledPA();
+		bool startWatch = m_handler->getWatchPending();
+		if (!startController && !startWatch) {
+			return;
+		}
+
+		if (std::shared_ptr<Client> target = findClient(client)) {
+			m_eventClient = client;
+			m_handler->setEventClient(target->settings);
+		}
+
+		if (startController) {
+			m_handler->startControllerThread(m_senderQueue, m_senderCv, m_stop, m_error);
+		}
+
+		if (startWatch) {
+			m_handler->startWatchThread(m_senderQueue, m_senderCv, m_stop, m_error);
+		}
+	}
+
+	/**
+	 * @brief Queue one chunk of a streamed response, waiting while the sender thread is behind so buffering stays bounded.
+	 * @param The chunk to send.
+	 * @return false if the connection failed or is stopping.
+	 */
+	bool SocketConnection::pushResponseChunk(std::vector<char>&& chunk) {
+		std::shared_ptr<Client> client = findClient(m_streamClient);
+		if (!client) {
+			return false;
+		}
+
+		m_handler->compressResponse(chunk);
+
+		std::unique_lock<std::mutex> lock(m_senderMutex);
+		while (client->sendQueue.size() >= ResponseStreamDepth && !client->closed && !m_error && !m_stop) {
+			m_senderCv.wait_for(lock, std::chrono::milliseconds(1));
+		}
+
+		if (m_error || m_stop || client->closed || !client->sendQueue.push(std::move(chunk))) {
+			return false;
+		}
+
+		m_senderCv.notify_all();
+		return true;
+	}
+
 	void SocketConnection::stopThreads() {
         if (!getThreadsInitialized()) {
 			return;
@@ -297,9 +685,13 @@ namespace SocketConnection {
 		notifyAll();
 		if (m_senderThread.joinable()) m_senderThread.join();
 		if (m_commandThread.joinable()) m_commandThread.join();
+		m_lanes.join();
 		if (m_handler) m_handler->cqJoinThread();
+		if (m_handler) m_handler->watchJoinThread();
 		m_senderQueue.clear();
 		m_commandQueue.clear();
+		m_eventClient = 0;
+		m_handler->setEventClient(nullptr);
 		m_error = false;
         m_stop = false;
 		m_commandInitialized = false;
@@ -307,7 +699,7 @@ namespace SocketConnection {
     }
 
 	void SocketConnection::disconnect() {
-		if (m_tcp.clientFd == -1 && m_tcp.serverFd == -1) {
+		if (m_tcp.serverFd == -1 && getClients().empty()) {
 			return;
         }
 
@@ -323,7 +715,7 @@ namespace SocketConnection {
 		try {
 			while (!m_error) {
 				try {
-					if (receiveData(m_tcp.clientFd) < 0) {
+					if (receiveData() < 0) {
 						m_error = true;
 						notifyAll();
 						break;
@@ -342,7 +734,6 @@ namespace SocketConnection {
 			}
 
 			Logger::instance().log("Main socket thread exiting.");
-			m_persistentBuffer.clear();
 		} catch (const std::exception& e) {
 			Logger::instance().log("Exception in SocketConnection::run(): ", e.what());
 			m_error = true;
@@ -354,110 +745,280 @@ namespace SocketConnection {
 		}
 	}
 
-	int SocketConnection::receiveData(int sockfd) {
+	/**
+	 * @brief Wait for any client to send data or a new client to connect, then handle it.
+	 * @return -1 once the last client has disconnected or the connection failed, else 0.
+	 */
+	int SocketConnection::receiveData(int) {
+		fd_set readfds;
+		FD_ZERO(&readfds);
+		FD_SET(m_tcp.serverFd, &readfds);
+		int maxFd = m_tcp.serverFd;
+		int udpFd = m_udp.getFd();
+		if (udpFd != -1) {
+			FD_SET(udpFd, &readfds);
+			maxFd = std::max(maxFd, udpFd);
+		}
+
+		std::vector<std::shared_ptr<Client>> clients = getClients();
+		for (auto& client : clients) {
+			if (client->closed) {
+				closeClient(client); // The sender thread failed to write to it.
+				continue;
+			}
+
+			FD_SET(client->fd, &readfds);
+			maxFd = std::max(maxFd, client->fd);
+		}
+
+		if (getClients().empty()) {
+			Logger::instance().log("receiveData(): last client closed the connection.", "", true);
+			return -1;
+		}
+
+		// Data and connections wake this straight away; the timeout only bounds how long errors and clients the sender thread closed go unnoticed.
+		struct timeval timeout { 0, SelectTimeoutUs };
+		int ready = select(maxFd + 1, &readfds, nullptr, nullptr, &timeout);
+		if (ready < 0) {
+			if (errno == EINTR) {
+				return 0;
+			}
+
+			Logger::instance().log("receiveData(): select() error.", std::string(strerror(errno)));
+			return -1;
+		}
+
+		// Controller queue datagrams first: they are the latency-critical traffic.
+		if (ready > 0 && udpFd != -1 && FD_ISSET(udpFd, &readfds)) {
+			m_udp.receive(*m_handler);
+		}
+
+		if (ready > 0 && FD_ISSET(m_tcp.serverFd, &readfds)) {
+			acceptClient();
+		}
+
+		for (auto& client : clients) {
+			if (ready > 0 && !client->closed && FD_ISSET(client->fd, &readfds) && receiveFromClient(*client) < 0) {
+				closeClient(client);
+			}
+		}
+
+		return !m_error ? 0 : -1;
+	}
+
+	/**
+	 * @brief Read what one client sent and queue each complete command or frame, using that client's protocol settings.
+	 * @param The client.
+	 * @return -1 if the client disconnected or sent a malformed frame, else 0.
+	 */
+	int SocketConnection::receiveFromClient(Client& client) {
 		constexpr size_t bufSize = 4096;
 		char buf[bufSize];
 
-		while (!m_error) {
-			ssize_t received = recv(sockfd, buf, bufSize, 0);
-			if (received > 0) {
-				try {
-					m_persistentBuffer.append(buf, received);
-				} catch (const std::exception& e) {
-					Logger::instance().log("receiveData(): Failed to append to persistent buffer: ", e.what());
-					m_persistentBuffer.clear();
-					continue;
-				}
+		ModuleBase::ClientScope scope(*client.settings);
+		ssize_t received = recv(client.fd, buf, bufSize, 0);
+		if (received == 0) {
+			return -1;
+		} else if (received < 0) {
+			if (errno == EWOULDBLOCK || errno == EAGAIN) {
+				return 0;
+			}
 
-				size_t pos;
-				while ((pos = m_persistentBuffer.find("\r\n")) != std::string::npos && !m_error) {
-					auto cmd = m_persistentBuffer.substr(0, pos + 2);
-					m_persistentBuffer.erase(0, pos + 2);
-
-					if (m_handler->getIsRunningPA()) {
-						Utils::parseArgs(cmd, [&](const std::string& command, const std::vector<std::string>& params) {
-							if (command == "cqCancel") {
-								m_handler->cqCancel();
-							} else if (command == "cqReplaceOnNext") {
-								m_handler->cqReplaceOnNext();
-							} else if (command == "cqControllerState") {
-								Controller::ControllerCommand controllerCmd {};
-								controllerCmd.parseFromHex(params.front().data());
-								m_handler->cqEnqueueCommand(controllerCmd);
-							} else if (command == "ping" && params.size() == 1) {
-								std::lock_guard<std::mutex> lock(m_senderMutex);
-								std::string response = command + " " + params.front() + "\r\n";
-                                sendData(response.data(), response.size(), sockfd);
-							} else {
-								if (!m_commandQueue.full()) {
-									m_commandQueue.push(std::move(cmd));
-									m_commandCv.notify_one();
-									return;
-								}
+			Logger::instance().log("receiveData(): recv() error.", std::string(strerror(errno)));
+			return -1;
+		}
 
-								Logger::instance().log("Command queue full, dropping command.");
-							}
-						});
-					} else {
-						if (!m_commandQueue.full()) {
-							m_commandQueue.push(std::move(cmd));
-							m_commandCv.notify_one();
-						} else {
-							Logger::instance().log("Command queue full, dropping command.");
+		try {
+			client.receiveBuffer.append(buf, received);
+		} catch (const std::exception& e) {
+			Logger::instance().log("receiveData(): Failed to append to receive buffer: ", e.what());
+			client.receiveBuffer.clear();
+			return 0;
+		}
+
+		if (m_handler->isBinaryProtocol()) {
+			std::string frame;
+			int rc = 0;
+			while (!m_error && (rc = Protocol::Frame::extract(client.receiveBuffer, frame)) > 0) {
+				Priority priority = Handler::getReceiveFramePriority(frame);
+				queueCommand(std::move(frame), priority, client.id);
+			}
+
+			return rc < 0 ? -1 : 0;
+		}
+
+		size_t pos;
+		while ((pos = client.receiveBuffer.find("\r\n")) != std::string::npos && !m_error) {
+			auto cmd = client.receiveBuffer.substr(0, pos + 2);
+			client.receiveBuffer.erase(0, pos + 2);
+
+			// Only controller queue commands are handled here, so other lines skip tokenizing until the command thread.
+			std::string_view name = Utils::firstToken(cmd);
+			if (m_handler->getIsRunningPA() && (name.starts_with("cq") || name == "ping")) {
+				Utils::parseArgs(cmd, m_receiveTokens, [&](std::string_view command, Args params) {
+					if (command == "cqCancel") {
+						m_handler->cqCancel();
+					} else if (command == "cqReplaceOnNext") {
+						m_handler->cqReplaceOnNext();
+					} else if (command == "cqControllerState") {
+						Controller::ControllerCommand controllerCmd {};
+						char hex[64] = {};
+						if (!params.empty()) {
+							std::memcpy(hex, params.front().data(), std::min(params.front().size(), sizeof(hex)));
 						}
+
+						controllerCmd.parseFromHex(hex);
+						m_handler->cqEnqueueCommand(controllerCmd);
+					} else if (command == "ping" && params.size() == 1) {
+						std::lock_guard<std::mutex> lock(client.sendMutex);
+						std::string response = std::string(command) + " " + std::string(params.front()) + "\r\n";
+						m_sendStats.responses++;
+						if (!client.closed && sendData(response.data(), response.size(), client.fd) < 0) {
+							client.closed = true;
+						}
+					} else {
+						queueCommand(std::move(cmd), Priority::Bulk, client.id);
 					}
-				}
+				});
+			} else {
+				Priority priority = Handler::getReceivePriority(cmd);
+				queueCommand(std::move(cmd), priority, client.id);
+			}
+		}
+
+		return 0;
+	}
 
-//				Logger::instance().log("Queue sizes - Command: " + std::to_string(m_commandQueue.size()) +
-//					", Sender: " + std::to_string(m_senderQueue.size()));
+	/**
+	 * @brief Send what is queued for a client, coalescing replies into one write up to the client's sendBatch budget.
+	 * A reply that would overflow the budget goes out in its own write straight after, so large streamed chunks aren't copied.
+	 * With sendLinger set, a lone small reply is held on the client until its deadline or until another reply joins it.
+	 * @param The client.
+	 * @param[in,out] Moved earlier to the deadline of a reply held back for sendLinger.
+	 * @return false if nothing was sent.
+	 */
+	bool SocketConnection::sendBatch(Client& client, std::chrono::steady_clock::time_point& wake) {
+		std::vector<char> batch;
+		bool held = !client.lingering.empty();
+		if (held) {
+			batch.swap(client.lingering);
+		} else if (!client.sendQueue.pop(batch)) {
+			return false;
+		}
 
-				continue;
-			} else if (received == 0) {
-				Logger::instance().log("receiveData(): client closed the connection.", "", true);
-				m_error = true;
-				notifyAll();
-				return -1;
-			} else if (received == -1 && errno != EWOULDBLOCK && errno != EAGAIN) {
-				Logger::instance().log("receiveData(): recv() error.", std::string(strerror(errno)));
-				m_error = true;
-				notifyAll();
-				return -1;
+		// A lone reply is parked on the client rather than waited on here, so one client's linger never delays another's sends.
+		u64 budget = client.settings->sendBatchBytes;
+		u64 linger = client.settings->sendLingerUs;
+		if (linger > 0 && batch.size() < budget && client.sendQueue.empty() && !m_error && !m_stop) {
+			auto now = std::chrono::steady_clock::now();
+			if (!held) {
+				client.lingerDeadline = now + std::chrono::microseconds(linger);
 			}
 
-			if (errno == EWOULDBLOCK || errno == EAGAIN) {
-				svcSleepThread(1e+6L);
+			if (now < client.lingerDeadline) {
+				client.lingering.swap(batch);
+				wake = std::min(wake, client.lingerDeadline);
+				return false;
 			}
 		}
 
-		return !m_error ? 0 : -1;
+		u64 responses = 1;
+		std::vector<char> next;
+		bool overflow = false;
+		while (batch.size() < budget && client.sendQueue.pop(next)) {
+			if (batch.size() + next.size() > budget) {
+				overflow = true;
+				break;
+			}
+
+			if (responses == 1) {
+				BufferPool::Pool::instance().reserve(batch, budget);
+			}
+
+			batch.insert(batch.end(), next.begin(), next.end());
+			BufferPool::Pool::instance().release(std::move(next));
+			responses++;
+		}
+
+		m_sendStats.responses += responses;
+		if (responses > 1) {
+			m_sendStats.coalesced++;
+		}
+
+		sendToClient(client, batch);
+		BufferPool::Pool::instance().release(std::move(batch));
+		if (overflow) {
+			m_sendStats.responses++;
+			sendToClient(client, next);
+			BufferPool::Pool::instance().release(std::move(next));
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief Send a buffer to one client. On failure the client is marked closed, and the receive thread drops it on its next pass.
+	 * @param The client.
+	 * @param The data to send.
+	 * @return false if the client is closed or the send failed.
+	 */
+	bool SocketConnection::sendToClient(Client& client, std::vector<char>& buffer) {
+		std::lock_guard<std::mutex> lock(client.sendMutex);
+		if (client.closed) {
+			return false;
+		}
+
+		if (sendData(buffer.data(), buffer.size(), client.fd) <= 0) {
+			Logger::instance().log("sendData() failed or client " + std::to_string(client.id) + " disconnected.");
+			client.closed = true;
+			client.sendQueue.clear();
+			return false;
+		}
+
+		return true;
 	}
 
 	int SocketConnection::sendData(const char* buffer, size_t size, int sockfd) {
 		ssize_t total = 0;
 		while (total < (ssize_t)size && !m_error) {
 			ssize_t sent = send(sockfd, buffer + total, size - total, 0);
+			m_sendStats.sends++;
 			if (sent > 0) {
+				m_sendStats.bytes += sent;
 				total += sent;
 				continue;
 			}
 
+			// Only this client is dropped; the others keep their connections.
 			if (sent == 0) {
 				Logger::instance().log("sendData(): Failed to send data. Client closed the connection.", "", true);
-				m_error = true;
-				notifyAll();
 				return -1;
 			} else if (sent == -1 && errno != EWOULDBLOCK && errno != EAGAIN) {
 				Logger::instance().log("sendData(): Failed to send data. send() error.", std::string(strerror(errno)));
-				m_error = true;
-				notifyAll();
 				return -1;
 			}
 
-			if (errno == EWOULDBLOCK || errno == EAGAIN) {
-				svcSleepThread(1e+6L);
+			if (waitWritable(sockfd) < 0) {
+				Logger::instance().log("sendData(): select() error.", std::string(strerror(errno)));
+				return -1;
 			}
 		}
 
 		return !m_error ? total : -1;
 	}
+
+	/**
+	 * @brief Block until the send buffer has room, so a full buffer costs only as long as the network takes to drain it.
+	 * @param The socket.
+	 * @return 1 if writable, 0 if the timeout passed first (the caller re-checks for errors and retries), -1 on error.
+	 */
+	int SocketConnection::waitWritable(int sockfd) {
+		fd_set writefds;
+		FD_ZERO(&writefds);
+		FD_SET(sockfd, &writefds);
+
+		struct timeval timeout { 0, SelectTimeoutUs };
+		int ready = select(sockfd + 1, nullptr, &writefds, nullptr, &timeout);
+		return ready < 0 && errno == EINTR ? 0 : ready;
+	}
 }
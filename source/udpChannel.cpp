@@ -0,0 +1,195 @@
+#include "defines.h"
+#include "udpChannel.h"
+#include "logger.h"
+#include "util.h"
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/errno.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+
+namespace UdpChannel {
+    using namespace SbbLog;
+    using namespace Util;
+    using CommandHandler::Handler;
+
+    /**
+     * @brief Bind the non-blocking datagram socket. The socket connection's select() loop reads it alongside the TCP clients.
+     * @param The UDP port.
+     * @return false if the socket could not be set up.
+     */
+    bool Channel::open(u16 port) {
+        if (getFd() != -1) {
+            return true;
+        }
+
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            Logger::instance().log("UDP socket() error.", std::to_string(errno));
+            return false;
+        }
+
+        int flags = 1;
+        if (ioctl(fd, FIONBIO, &flags) < 0) {
+            Logger::instance().log("UDP ioctl(FIONBIO) error.", std::to_string(errno));
+            ::close(fd);
+            return false;
+        }
+
+        struct sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(port);
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            Logger::instance().log("UDP bind() error.", std::to_string(errno));
+            ::close(fd);
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hasPeer = false;
+        m_lastSeq = 0;
+        m_lastFinished = 0;
+        m_pending.clear();
+        m_fd = fd;
+        Logger::instance().log("UDP channel listening on port " + std::to_string(port) + ".");
+        return true;
+    }
+
+    void Channel::close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int fd = m_fd.exchange(-1);
+        if (fd != -1) {
+            ::close(fd);
+        }
+
+        m_hasPeer = false;
+        m_pending.clear();
+    }
+
+    /**
+     * @brief Handle every datagram waiting on the socket.
+     * @param The handler whose controller queue the commands go to.
+     */
+    void Channel::receive(Handler& handler) {
+        char buf[MaxDatagram];
+        while (getFd() != -1) {
+            struct sockaddr_in from {};
+            socklen_t fromSize = sizeof(from);
+            ssize_t received = recvfrom(getFd(), buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromSize);
+            if (received <= 0) {
+                if (received < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
+                    Logger::instance().log("UDP recvfrom() error.", std::string(strerror(errno)));
+                }
+
+                return;
+            }
+
+            handleDatagram(handler, std::string_view(buf, received), from);
+        }
+    }
+
+    /**
+     * @brief Apply one datagram if its sequence number is new, then acknowledge it.
+     * Replies are "ack {seq} {last finished seqnum}", "rejected {seq}" while the controller queue isn't running, or "error {seq}" for anything else.
+     * @param The handler whose controller queue the command goes to.
+     * @param The datagram.
+     * @param The sender.
+     */
+    void Channel::handleDatagram(Handler& handler, std::string_view datagram, const struct sockaddr_in& from) {
+        Utils::parseArgs(datagram, m_tokens, [&](std::string_view seqToken, Args args) {
+            u64 seq = 0;
+            if (!Utils::parseInt(seqToken, seq)) {
+                return;
+            }
+
+            std::string_view command = args.empty() ? std::string_view() : args.front();
+            Args params = args.empty() ? args : args.subspan(1);
+            if (command != "cqControllerState" && command != "cqCancel" && command != "cqReplaceOnNext") {
+                sendTo("error " + std::to_string(seq) + "\r\n", from);
+                return;
+            }
+
+            if (!handler.getIsRunningPA()) {
+                sendTo("rejected " + std::to_string(seq) + "\r\n", from);
+                return;
+            }
+
+            Handler::ControllerCommand controllerCmd {};
+            if (command == "cqControllerState") {
+                char hex[64] = {};
+                if (!params.empty()) {
+                    std::memcpy(hex, params.front().data(), std::min(params.front().size(), sizeof(hex)));
+                }
+
+                controllerCmd.parseFromHex(hex);
+            }
+
+            bool fresh = false;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                // A new sender starts a new sequence, so a restarted client isn't ignored as a replay.
+                if (!m_hasPeer || from.sin_addr.s_addr != m_peer.sin_addr.s_addr || from.sin_port != m_peer.sin_port) {
+                    m_peer = from;
+                    m_hasPeer = true;
+                    m_lastSeq = 0;
+                    m_pending.clear();
+                }
+
+                fresh = seq > m_lastSeq;
+                if (fresh) {
+                    m_lastSeq = seq;
+                    if (command == "cqControllerState") {
+                        if (m_pending.size() >= MaxPending) {
+                            m_pending.pop_front();
+                        }
+
+                        m_pending.push_back(controllerCmd.seqnum);
+                    }
+                }
+            }
+
+            // The controller lock is taken outside ours; the controller thread takes them in the other order when a command finishes.
+            if (fresh) {
+                if (command == "cqCancel") {
+                    handler.cqCancel();
+                } else if (command == "cqReplaceOnNext") {
+                    handler.cqReplaceOnNext();
+                } else {
+                    handler.cqEnqueueCommand(controllerCmd);
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            sendTo("ack " + std::to_string(seq) + " " + std::to_string(m_lastFinished) + "\r\n", from);
+        });
+    }
+
+    /**
+     * @brief Report a finished controller command over UDP if it was scheduled here. Called on the controller thread.
+     * The last finished seqnum also rides on every ack, so a lost completion is recovered by the next reply.
+     * @param The controller command's seqnum.
+     * @return false if the command came over TCP, which then reports it as usual.
+     */
+    bool Channel::sendFinished(u64 seqnum) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = std::find(m_pending.begin(), m_pending.end(), seqnum);
+        if (getFd() == -1 || !m_hasPeer || it == m_pending.end()) {
+            return false;
+        }
+
+        // Commands queued before this one have finished or were cancelled.
+        m_pending.erase(m_pending.begin(), it + 1);
+        m_lastFinished = seqnum;
+        sendTo("cqCommandFinished " + std::to_string(seqnum) + "\r\n", m_peer);
+        return true;
+    }
+
+    void Channel::sendTo(const std::string& message, const struct sockaddr_in& peer) {
+        if (sendto(getFd(), message.data(), message.size(), 0, (const struct sockaddr*)&peer, sizeof(peer)) < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
+            Logger::instance().log("UDP sendto() error.", std::string(strerror(errno)));
+        }
+    }
+}
@@ -3,6 +3,7 @@
 #include "usbConnection.h"
 #include "commandHandler.h"
 #include "util.h"
+#include "bufferPool.h"
 #include <cstring>
 
 namespace UsbConnection {
@@ -41,6 +42,9 @@ namespace UsbConnection {
                                 m_senderQueue.clear();
                                 break;
                             }
+
+                            BufferPool::Pool::instance().release(std::move(buffer));
+                            m_senderCv.notify_all();
                         }
 
                         std::unique_lock<std::mutex> lock(m_senderMutex);
@@ -64,29 +68,53 @@ namespace UsbConnection {
             m_commandThread = std::thread([&]() {
                 Logger::instance().log("USB command thread starting...");
                 m_commandInitialized = true;
+                std::vector<std::string_view> tokens;
                 while (!m_stop) {
                     try {
                         std::string command;
-                        while (m_commandQueue.pop(command) && !m_error) {
-                            Utils::parseArgs(command, [&](const std::string& x, const std::vector<std::string>& y) {
-                                auto buffer = m_handler->HandleCommand(x, y);
-                                if (!m_handler->getIsRunningPA() && m_handler->getIsEnabledPA()) {
-                                    m_handler->startControllerThread(m_senderQueue, m_senderCv, m_stop, m_error);
+                        Priority priority;
+                        u32 client;
+                        while (m_commandQueue.pop(command, priority, client) && !m_error) {
+                            // Urgent commands skip the lane barrier, but still run after whatever this thread is doing now: an untagged command, a barrier or a push to a full lane.
+                            bool urgent = priority == Priority::Urgent;
+                            if (m_handler->isBinaryProtocol()) {
+                                Lane lane = Handler::getFrameLane(command);
+                                if (!urgent && lane != Lane::Barrier) {
+                                    m_lanes.push(lane, CommandLanes::Request { "", std::move(command), true });
+                                    continue;
+                                }
+
+                                if (!urgent) {
+                                    m_lanes.barrier();
                                 }
 
+                                auto buffer = m_handler->HandleFrame(command);
+                                startHandlerThreads();
                                 if (!buffer.empty()) {
-                                    if (!g_enableBackwardsCompat && buffer.back() != '\n') {
-                                        buffer.push_back('\n');
-                                    }
-
-                                    Logger::instance().log("Command processed: " + x + ".");
-                                    if (m_senderQueue.full()) {
-                                        Logger::instance().log("Sender queue full, dropping response.");
-                                        return;
-                                    }
-
-                                    m_senderQueue.push(std::move(buffer));
-                                    m_senderCv.notify_one();
+                                    queueFrame(std::move(buffer));
+                                }
+
+                                continue;
+                            }
+
+                            std::string requestId = Utils::takeRequestId(command);
+                            Utils::parseArgs(command, tokens, [&](std::string_view x, Args y) {
+                                // Untagged bulk commands keep strict ordering: every lane drains before they run.
+                                Lane lane = requestId.empty() ? Lane::Barrier : Handler::getLane(x);
+                                if (!urgent && lane != Lane::Barrier) {
+                                    m_lanes.push(lane, CommandLanes::Request { requestId, std::move(command), false });
+                                    return;
+                                }
+
+                                if (!urgent) {
+                                    m_lanes.barrier();
+                                }
+
+                                auto buffer = m_handler->HandleCommand(x, y);
+                                startHandlerThreads();
+                                if (!buffer.empty() || !requestId.empty()) {
+                                    Logger::instance().log("Command processed: " + std::string(x) + ".");
+                                    queueResponse(std::move(buffer), requestId);
                                 }
                             });
                         }
@@ -105,9 +133,12 @@ namespace UsbConnection {
                     }
                 }
 
+                m_handler->endClientSession();
                 Logger::instance().log("USB command thread exiting.");
                 stopThreads();
             });
+
+            m_lanes.start([this](CommandLanes::Request& request, std::vector<std::string_view>& tokens) { runLaneRequest(request, tokens); });
         } catch (const std::exception& e) {
             Logger::instance().log("Exception while starting threads: ", e.what());
             stopThreads();
@@ -117,6 +148,140 @@ namespace UsbConnection {
         }
     }
 
+    /**
+     * @brief Terminate and compress a text response, tag it, then queue it for the sender thread.
+     * The "#id " prefix goes in front of any compression header, so a pipelining client can match the reply before decompressing it.
+     * @param The response. Empty for a tagged command that returned nothing; it is still answered with the bare prefix.
+     * @param The request id to echo as a "#id " prefix, or empty.
+     */
+    void UsbConnection::queueResponse(std::vector<char>&& buffer, const std::string& requestId) {
+        if (!g_enableBackwardsCompat && (buffer.empty() || buffer.back() != '\n')) {
+            buffer.push_back('\n');
+        }
+
+        m_handler->compressResponse(buffer);
+        if (!requestId.empty()) {
+            std::string prefix = "#" + requestId + " ";
+            buffer.insert(buffer.begin(), prefix.begin(), prefix.end());
+        }
+
+        queueFrame(std::move(buffer));
+    }
+
+    /**
+     * @brief Queue a finished response for the sender thread as-is.
+     * @param The response.
+     */
+    void UsbConnection::queueFrame(std::vector<char>&& buffer) {
+        if (buffer.empty()) {
+            return;
+        }
+
+        if (m_senderQueue.full()) {
+            Logger::instance().log("Sender queue full, dropping response.");
+            return;
+        }
+
+        m_senderQueue.push(std::move(buffer));
+        m_senderCv.notify_one();
+    }
+
+    /**
+     * @brief Queue a received command or frame for the command thread. Urgent and bulk commands have separate queues, so an urgent one is popped ahead of the bulk backlog.
+     * @param The command line or frame.
+     * @param Its priority.
+     */
+    void UsbConnection::queueCommand(std::string&& command, Priority priority) {
+        if (!m_commandQueue.push(priority, std::move(command))) {
+            Logger::instance().log(priority == Priority::Urgent ? "Urgent command queue full, dropping command." : "Bulk command queue full, dropping command.");
+            return;
+        }
+
+        m_commandCv.notify_one();
+    }
+
+    /**
+     * @brief Run a tagged request on its lane worker and queue the reply. Streaming is off, so a large peek can't interleave with other lanes.
+     * A request that throws is answered with an error reply ("#id error", or an error frame) and the lane carries on.
+     * @param The request.
+     * @param Scratch storage for the lane's tokens.
+     */
+    void UsbConnection::runLaneRequest(CommandLanes::Request& request, std::vector<std::string_view>& tokens) {
+        try {
+            handleLaneRequest(request, tokens);
+        } catch (const std::exception& e) {
+            Logger::instance().log("Lane request exception: ", e.what());
+            queueLaneError(request);
+        }
+    }
+
+    void UsbConnection::handleLaneRequest(CommandLanes::Request& request, std::vector<std::string_view>& tokens) {
+        if (request.frame) {
+            queueFrame(m_handler->HandleFrame(request.command, false));
+            startHandlerThreads();
+            return;
+        }
+
+        Utils::parseArgs(request.command, tokens, [&](std::string_view x, Args y) {
+            auto buffer = m_handler->HandleCommand(x, y, false);
+            startHandlerThreads();
+            if (!buffer.empty() || !request.requestId.empty()) {
+                Logger::instance().log("Lane command processed: " + std::string(x) + ".");
+                queueResponse(std::move(buffer), request.requestId);
+            }
+        });
+    }
+
+    /**
+     * @brief Answer a lane request that failed, so the client isn't left waiting on its request id.
+     * @param The request.
+     */
+    void UsbConnection::queueLaneError(const CommandLanes::Request& request) {
+        if (request.frame) {
+            Protocol::FrameHeader header;
+            std::memcpy(&header, request.command.data(), sizeof(header));
+            queueFrame(Protocol::Frame::make(header.opcode, Protocol::Flags::Error, header.requestId, nullptr, 0));
+            return;
+        }
+
+        static constexpr std::string_view error = "error";
+        queueResponse(std::vector<char>(error.begin(), error.end()), request.requestId);
+    }
+
+    /**
+     * @brief Start the PA controller and watch threads once the last command enabled them.
+     */
+    void UsbConnection::startHandlerThreads() {
+        if (!m_handler->getIsRunningPA() && m_handler->getIsEnabledPA()) {
+            m_handler->startControllerThread(m_senderQueue, m_senderCv, m_stop, m_error);
+        }
+
+        if (m_handler->getWatchPending()) {
+            m_handler->startWatchThread(m_senderQueue, m_senderCv, m_stop, m_error);
+        }
+    }
+
+    /**
+     * @brief Queue one chunk of a streamed response, waiting while the sender thread is behind so buffering stays bounded.
+     * @param The chunk to send.
+     * @return false if the connection failed or is stopping.
+     */
+    bool UsbConnection::pushResponseChunk(std::vector<char>&& chunk) {
+        m_handler->compressResponse(chunk);
+
+        std::unique_lock<std::mutex> lock(m_senderMutex);
+        while (m_senderQueue.size() >= ResponseStreamDepth && !m_error && !m_stop) {
+            m_senderCv.wait_for(lock, std::chrono::milliseconds(1));
+        }
+
+        if (m_error || m_stop || !m_senderQueue.push(std::move(chunk))) {
+            return false;
+        }
+
+        m_senderCv.notify_all();
+        return true;
+    }
+
     void UsbConnection::stopThreads() {
         if (!getThreadsInitialized()) {
             return;
@@ -127,7 +292,9 @@ namespace UsbConnection {
         notifyAll();
         if (m_senderThread.joinable()) m_senderThread.join();
         if (m_commandThread.joinable()) m_commandThread.join();
+        m_lanes.join();
         if (m_handler) m_handler->cqJoinThread();
+        if (m_handler) m_handler->watchJoinThread();
         m_senderQueue.clear();
         m_commandQueue.clear();
         m_error = false;
@@ -159,7 +326,8 @@ namespace UsbConnection {
             }
 
             Logger::instance().log("Main USB thread exiting.");
-            m_persistentBuffer.clear();
+            m_receiveRing.clear();
+            std::string().swap(m_spill);
         } catch (const std::exception& e) {
             Logger::instance().log("Exception in USBConnection::run(): ", e.what());
             m_error = true;
@@ -183,14 +351,12 @@ namespace UsbConnection {
     int UsbConnection::receiveData(int sockfd) {
         while (!m_error) {
             try {
-                size_t bufSize = 4096;
-                std::vector<char> buf(bufSize);
-
+                size_t expected = 0;
                 if (g_enableBackwardsCompat) {
                     char header[4];
                     size_t headerRead = 0;
                     while (headerRead < 4 && !m_error) {
-                        ssize_t readBytes = usbCommsRead(&header + headerRead, 4 - headerRead);
+                        ssize_t readBytes = usbCommsRead(header + headerRead, 4 - headerRead);
                         if (readBytes <= 0) {
                             break;
                         }
@@ -201,65 +367,57 @@ namespace UsbConnection {
                     if (headerRead > 2) {
                         uint32_t dataSize = 0;
                         std::memcpy(&dataSize, header, 4);
-                        buf.resize(dataSize - 2);
+                        expected = m_handler->isBinaryProtocol() ? dataSize : (dataSize > 2 ? dataSize - 2 : 0);
                     }
                 }
 
-                ssize_t received = usbCommsRead((void*)buf.data(), buf.size());
-                if (received > 0) {
-                    m_persistentBuffer.append(buf.data(), received);
-                    fflush(stdout);
-                    if (g_enableBackwardsCompat) {
-                        m_persistentBuffer.append("\r\n");
-                    }
+                // Each read is still one usbCommsRead() of the announced size, or of ReadChunkSize, landing straight in the ring.
+                size_t wanted = expected > 0 ? expected : ReadChunkSize;
+                size_t available = 0;
+                char* space = m_receiveRing.writeSpace(available);
+                if (available < wanted) {
+                    spillReceived();
+                    space = m_receiveRing.writeSpace(available);
+                }
 
-                    size_t pos;
-                    while ((pos = m_persistentBuffer.find("\r\n")) != std::string::npos && !m_error) {
-                        auto cmd = m_persistentBuffer.substr(0, pos + 2);
-                        m_persistentBuffer.erase(0, pos + 2);
-
-                        if (m_handler->getIsRunningPA()) {
-                            Utils::parseArgs(cmd, [&](const std::string& command, const std::vector<std::string>& params) {
-                                if (command == "cqCancel") {
-                                    m_handler->cqCancel();
-                                } else if (command == "cqReplaceOnNext") {
-                                    m_handler->cqReplaceOnNext();
-                                } else if (command == "cqControllerState") {
-                                    Controller::ControllerCommand controllerCmd{};
-                                    controllerCmd.parseFromHex(params.front().data());
-                                    m_handler->cqEnqueueCommand(controllerCmd);
-                                } else if (command == "ping" && params.size() == 1) {
-                                    std::lock_guard<std::mutex> lock(m_senderMutex);
-                                    std::string response = command + " " + params.front() + "\r\n";
-                                    sendData(response.data(), response.size());
-                                } else {
-                                    m_commandQueue.push(std::move(cmd));
-                                    m_commandCv.notify_one();
-                                }
-                            });
-                        } else {
-                            m_commandQueue.push(std::move(cmd));
-                            m_commandCv.notify_one();
-                        }
+                ssize_t received = 0;
+                if (wanted <= available) {
+                    received = usbCommsRead(space, wanted);
+                    if (received > 0) {
+                        m_receiveRing.commit(received);
                     }
+                } else {
+                    size_t offset = m_spill.size();
+                    m_spill.resize(offset + wanted);
+                    received = usbCommsRead(m_spill.data() + offset, wanted);
+                    m_spill.resize(offset + std::max<ssize_t>(received, 0));
+                }
 
-                    continue;
-                } else if (received == 0) {
+                if (received == 0) {
                     Logger::instance().log("receiveData() client closed the connection.", std::string(strerror(errno)));
-                    fflush(stdout);
                     m_error = true;
                     notifyAll();
                     return -1;
-                } else {
+                } else if (received < 0) {
                     Logger::instance().log("receiveData() recv() error.", std::string(strerror(errno)));
-                    fflush(stdout);
+                    m_error = true;
+                    notifyAll();
+                    return -1;
+                }
+
+                // Backwards-compatible text commands arrive without a terminator.
+                if (g_enableBackwardsCompat && !m_handler->isBinaryProtocol() && !m_receiveRing.write("\r\n", 2)) {
+                    spillReceived();
+                    m_receiveRing.write("\r\n", 2);
+                }
+
+                if (!drainReceived()) {
                     m_error = true;
                     notifyAll();
                     return -1;
                 }
             } catch (...) {
                 Logger::instance().log("Exception in receiveData() while reading data.", "Unknown error.");
-                fflush(stdout);
                 m_error = true;
                 notifyAll();
                 return -1;
@@ -269,6 +427,98 @@ namespace UsbConnection {
         return 0;
     }
 
+    /**
+     * @brief Move the unread bytes out of the ring when the next read won't fit behind them, i.e. the command being received is bigger than the ring.
+     * This is the only case that allocates.
+     */
+    void UsbConnection::spillReceived() {
+        std::string_view pending = m_receiveRing.readable();
+        m_spill.append(pending.begin(), pending.end());
+        m_receiveRing.clear();
+    }
+
+    /**
+     * @brief Handle what has been read so far, in place in the ring unless an oversized command is being assembled in m_spill.
+     * @return false if a frame header was invalid.
+     */
+    bool UsbConnection::drainReceived() {
+        bool invalid = false;
+        if (m_spill.empty()) {
+            m_receiveRing.consume(handleReceived(m_receiveRing.readable(), invalid));
+            return !invalid;
+        }
+
+        spillReceived();
+        m_spill.erase(0, handleReceived(m_spill, invalid));
+
+        // Back to the ring once the oversized command is through, giving its memory back.
+        if (m_spill.size() < m_receiveRing.capacity()) {
+            m_receiveRing.write(m_spill.data(), m_spill.size());
+            std::string().swap(m_spill);
+        }
+
+        return !invalid;
+    }
+
+    /**
+     * @brief Queue every complete command or frame at the start of the received bytes. Controller queue commands and pings are handled straight from the view;
+     * anything queued for the command thread is copied out once, since the ring is reused before it runs.
+     * @param The received bytes.
+     * @param[out] Set if a frame header is invalid.
+     * @return How many bytes were handled.
+     */
+    size_t UsbConnection::handleReceived(std::string_view data, bool& invalid) {
+        size_t consumed = 0;
+        if (m_handler->isBinaryProtocol()) {
+            size_t size = 0;
+            int rc = 0;
+            while (!m_error && (rc = Protocol::Frame::measure(data.substr(consumed), size)) > 0) {
+                std::string frame(data.substr(consumed, size));
+                consumed += size;
+                Priority priority = Handler::getReceiveFramePriority(frame);
+                queueCommand(std::move(frame), priority);
+            }
+
+            invalid = rc < 0;
+            return consumed;
+        }
+
+        std::string_view cmd;
+        while (!m_error && ReceiveRing::Ring::takeLine(data, consumed, cmd)) {
+            // Only controller queue commands are handled here, so other lines skip tokenizing until the command thread.
+            std::string_view name = Utils::firstToken(cmd);
+            if (m_handler->getIsRunningPA() && (name.starts_with("cq") || name == "ping")) {
+                Utils::parseArgs(cmd, m_receiveTokens, [&](std::string_view command, Args params) {
+                    if (command == "cqCancel") {
+                        m_handler->cqCancel();
+                    } else if (command == "cqReplaceOnNext") {
+                        m_handler->cqReplaceOnNext();
+                    } else if (command == "cqControllerState") {
+                        Controller::ControllerCommand controllerCmd{};
+                        char hex[64] = {};
+                        if (!params.empty()) {
+                            std::memcpy(hex, params.front().data(), std::min(params.front().size(), sizeof(hex)));
+                        }
+
+                        controllerCmd.parseFromHex(hex);
+                        m_handler->cqEnqueueCommand(controllerCmd);
+                    } else if (command == "ping" && params.size() == 1) {
+                        std::lock_guard<std::mutex> lock(m_senderMutex);
+                        std::string response = std::string(command) + " " + std::string(params.front()) + "\r\n";
+                        sendData(response.data(), response.size());
+                    } else {
+                        queueCommand(std::string(cmd), Priority::Bulk);
+                    }
+                });
+            } else {
+                Priority priority = Handler::getReceivePriority(cmd);
+                queueCommand(std::string(cmd), priority);
+            }
+        }
+
+        return consumed;
+    }
+
     int UsbConnection::sendData(const char* buffer, size_t size, int sockfd) {
         size_t total = 0;
         USBResponse response {
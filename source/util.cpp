@@ -1,8 +1,14 @@
 #include "defines.h"
 #include "util.h"
+#include "config.h"
+#include "bufferPool.h"
 #include "logger.h"
+#include <array>
+#include <charconv>
 #include <cstring>
-#include <fstream>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 namespace Util {
     using namespace SbbLog;
@@ -80,29 +86,53 @@ namespace Util {
         }
     }
 
+    /**
+     * @brief Whether the running connection is USB. Reads the cached transport, so it is safe on every response.
+     */
     bool Utils::isUSB() {
-        std::vector<char> str(10);
-        std::ifstream cfg("sdmc:/atmosphere/contents/430000000000000B/config.cfg");
-        if (cfg.is_open()) {
-            cfg.getline(str.data(), str.size(), '\n');
-            cfg.close();
-
-            str.shrink_to_fit();
-            if (std::string(str.data()) == "usb") {
-                return true;
-            }
+        return Config::Settings::instance().transport() == Config::Transport::Usb;
+    }
+
+    /**
+     * @brief Strip a leading "#<digits>" request id from a command line.
+     * @param The command line, modified in place when an id is present.
+     * @return The request id without the '#', or an empty string if the line is untagged.
+     */
+    std::string Utils::takeRequestId(std::string& cmd) {
+        size_t start = 0, len = cmd.length();
+        while (start < len && std::isspace(cmd[start])) {
+            ++start;
         }
 
-        cfg.close();
-        return false;
+        if (start >= len || cmd[start] != '#') {
+            return {};
+        }
+
+        size_t end = start + 1;
+        while (end < len && std::isdigit(cmd[end])) {
+            ++end;
+        }
+
+        if (end == start + 1 || end > 11 + start || (end < len && !std::isspace(cmd[end]))) {
+            return {};
+        }
+
+        std::string id = cmd.substr(start + 1, end - start - 1);
+        cmd.erase(0, end);
+        return id;
     }
 
-    void Utils::parseArgs(const std::string& cmd, std::function<void(const std::string&, const std::vector<std::string>&)> callback) {
-        std::vector<std::string> params;
-        size_t start = 0, end = 0, len = cmd.length();
+    /**
+     * @brief Split a line on whitespace into views over the line. No token is copied.
+     * @param The line to split.
+     * @param[out] The tokens, cleared first. Keeps its capacity between calls.
+     */
+    void Utils::tokenize(std::string_view line, std::vector<std::string_view>& tokens) {
+        tokens.clear();
+        size_t start = 0, end = 0, len = line.length();
 
         while (start < len) {
-            while (start < len && std::isspace(cmd[start])) {
+            while (start < len && std::isspace(static_cast<unsigned char>(line[start]))) {
                 ++start;
             }
 
@@ -111,97 +141,276 @@ namespace Util {
             }
 
             end = start;
-            while (end < len && !std::isspace(cmd[end])) {
+            while (end < len && !std::isspace(static_cast<unsigned char>(line[end]))) {
                 ++end;
             }
 
-            std::string token = cmd.substr(start, end - start);
-            if (!token.empty() && token != "\n") {
-                params.push_back(token);
-            }
-
+            tokens.push_back(line.substr(start, end - start));
             start = end;
         }
+    }
 
-        if (params.empty()) {
-            return;
+    /**
+     * @brief Get the first whitespace-separated token of a line without tokenizing the rest.
+     * @param The line.
+     * @return The first token, or an empty view if the line is blank.
+     */
+    std::string_view Utils::firstToken(std::string_view line) {
+        size_t start = 0, len = line.length();
+        while (start < len && std::isspace(static_cast<unsigned char>(line[start]))) {
+            ++start;
         }
 
-        std::string command = params[0];
-        std::vector<std::string> parameters;
-        if (params.size() > 1) {
-            parameters.assign(params.begin() + 1, params.end());
+        size_t end = start;
+        while (end < len && !std::isspace(static_cast<unsigned char>(line[end]))) {
+            ++end;
         }
 
-        callback(command, parameters);
+        return line.substr(start, end - start);
     }
 
-    u64 Utils::parseStringToInt(const std::string& arg) {
-        if (arg.length() > 2 && arg[1] == 'x') {
-            return std::stoull(arg, NULL, 16);
+    /**
+     * @brief Get the command name of a line, skipping a leading "#<id>" request tag.
+     * @param The line.
+     * @return The command name, or an empty view if there is none.
+     */
+    std::string_view Utils::commandName(std::string_view line) {
+        std::string_view name = firstToken(line);
+        if (!name.starts_with('#')) {
+            return name;
         }
 
-        return std::stoull(arg, NULL, 10);
+        return firstToken(line.substr((name.data() - line.data()) + name.size()));
     }
 
-    s64 Utils::parseStringToSignedLong(const std::string& arg) {
-        if (arg.length() > 2 && (arg[1] == 'x' || arg[2] == 'x')) {
-            return std::stoll(arg, NULL, 16);
+    /**
+     * @brief Parse an unsigned decimal or "0x" hex integer without allocating or throwing.
+     * @param The text to parse.
+     * @param[out] The parsed value.
+     * @return false if the text is not entirely a number or overflows.
+     */
+    bool Utils::parseInt(std::string_view arg, u64& value) {
+        int base = 10;
+        if (arg.length() > 2 && arg[0] == '0' && (arg[1] == 'x' || arg[1] == 'X')) {
+            arg.remove_prefix(2);
+            base = 16;
         }
 
-        return std::stoll(arg, NULL, 10);
+        if (arg.empty()) {
+            return false;
+        }
+
+        auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), value, base);
+        return ec == std::errc() && ptr == arg.data() + arg.size();
     }
 
-    std::vector<char> Utils::parseStringToByteBuffer(const std::string& arg) {
-        std::string argStr = arg;
-        char toTranslate[3] = { 0 };
-        int length = argStr.length();
-        bool isHex = false;
-
-        if (length > 2) {
-            if (argStr[1] == 'x') {
-                isHex = true;
-                length -= 2;
-                argStr = &argStr[2]; //cut off 0x
-            }
+    /**
+     * @brief Parse a signed decimal or "0x" hex integer, optionally with a leading '-', without allocating or throwing.
+     * @param The text to parse.
+     * @param[out] The parsed value.
+     * @return false if the text is not entirely a number or overflows.
+     */
+    bool Utils::parseSignedInt(std::string_view arg, s64& value) {
+        bool negative = !arg.empty() && arg[0] == '-';
+        if (negative) {
+            arg.remove_prefix(1);
         }
 
-        bool isFirst = true;
-        bool isOdd = (length % 2 == 1);
-        u64 bufferSize = length / 2;
-        if (isOdd) {
-            bufferSize++;
+        u64 magnitude = 0;
+        if (!parseInt(arg, magnitude) || magnitude > (negative ? (u64)INT64_MAX + 1 : (u64)INT64_MAX)) {
+            return false;
         }
 
-        std::vector<char> buffer;
-        for (u64 i = 0; i < bufferSize; i++) {
-            if (isOdd) {
-                if (isFirst) {
-                    toTranslate[0] = '0';
-                    toTranslate[1] = argStr[i];
-                }
-                else {
-                    toTranslate[0] = argStr[(2 * i) - 1];
-                    toTranslate[1] = argStr[(2 * i)];
-                }
-            }
-            else {
-                toTranslate[0] = argStr[i * 2];
-                toTranslate[1] = argStr[(i * 2) + 1];
-            }
+        value = negative ? (s64)(0 - magnitude) : (s64)magnitude;
+        return true;
+    }
+
+    u64 Utils::parseStringToInt(std::string_view arg) {
+        u64 value = 0;
+        if (!parseInt(arg, value)) {
+            Logger::instance().log("parseStringToInt() invalid number: " + std::string(arg) + ".");
+            return 0;
+        }
+
+        return value;
+    }
+
+    s64 Utils::parseStringToSignedLong(std::string_view arg) {
+        s64 value = 0;
+        if (!parseSignedInt(arg, value)) {
+            Logger::instance().log("parseStringToSignedLong() invalid number: " + std::string(arg) + ".");
+            return 0;
+        }
+
+        return value;
+    }
+
+    /**
+     * @brief Parse a "0x" hex or decimal byte string, two digits per byte, without throwing. An odd digit count gets an implied leading zero.
+     * @param The text to parse.
+     * @param[out] The bytes.
+     * @return false if the text is empty or holds anything but digits of its base.
+     */
+    bool Utils::parseByteBuffer(std::string_view arg, std::vector<char>& buffer) {
+        int base = 10;
+        if (arg.length() > 2 && arg[1] == 'x') {
+            base = 16;
+            arg.remove_prefix(2); //cut off 0x
+        }
+
+        size_t length = arg.length();
+        buffer.clear();
+        if (length == 0) {
+            return false;
+        }
 
-            isFirst = false;
-            if (isHex) {
-                buffer.push_back(std::stoull(toTranslate, NULL, 16));
+        if (base == 16) {
+            buffer.resize((length + 1) / 2);
+            size_t first = length % 2;
+            bool valid = true;
+            if (first == 1) {
+                char digit[2] = { '0', arg[0] };
+                valid &= hexDecode(digit, 1, buffer.data());
             }
-            else {
-                buffer.push_back(std::stoull(toTranslate, NULL, 10));
+
+            valid &= hexDecode(arg.data() + first, length / 2, buffer.data() + first);
+            return valid;
+        }
+
+        size_t first = length % 2 == 1 ? 1 : 2;
+        buffer.reserve((length + 1) / 2);
+        for (size_t i = 0; i < length; i += (i == 0 ? first : 2)) {
+            size_t digits = i == 0 ? first : 2;
+            u8 byte = 0;
+            auto [ptr, ec] = std::from_chars(arg.data() + i, arg.data() + i + digits, byte, base);
+            if (ec != std::errc() || ptr != arg.data() + i + digits) {
+                return false;
             }
+
+            buffer.push_back(byte);
+        }
+
+        return true;
+    }
+
+    std::vector<char> Utils::parseStringToByteBuffer(std::string_view arg) {
+        std::vector<char> buffer;
+        if (!parseByteBuffer(arg, buffer)) {
+            Logger::instance().log("parseStringToByteBuffer() invalid data: " + std::string(arg) + ".");
+            buffer.clear();
         }
 
         return buffer;
     }
 
+    static constexpr char HexDigits[] = "0123456789ABCDEF";
+
+    // Nibble value of each character, or 0xFF if it is not a hex digit.
+    static constexpr auto HexValues = []() {
+        std::array<u8, 256> values {};
+        values.fill(0xFF);
+        for (int i = 0; i < 10; ++i) {
+            values['0' + i] = i;
+        }
+
+        for (int i = 0; i < 6; ++i) {
+            values['A' + i] = 10 + i;
+            values['a' + i] = 10 + i;
+        }
+
+        return values;
+    }();
+
+#if defined(__ARM_NEON)
+    /**
+     * @brief Encode 16 bytes to 32 upper-case hex characters.
+     * @param The 16 input bytes, already in output order.
+     * @param Output for 32 characters.
+     */
+    static inline void hexEncodeBlock(uint8x16_t in, char* dst) {
+        const uint8x16_t digits = vld1q_u8(reinterpret_cast<const uint8_t*>(HexDigits));
+        uint8x16_t hi = vqtbl1q_u8(digits, vshrq_n_u8(in, 4));
+        uint8x16_t lo = vqtbl1q_u8(digits, vandq_u8(in, vdupq_n_u8(0x0F)));
+        uint8x16x2_t out = vzipq_u8(hi, lo);
+        vst1q_u8(reinterpret_cast<uint8_t*>(dst), out.val[0]);
+        vst1q_u8(reinterpret_cast<uint8_t*>(dst) + 16, out.val[1]);
+    }
+
+    /**
+     * @brief Map 16 hex characters to their nibble values.
+     * @param The characters.
+     * @param[in,out] Cleared in every lane that is not a hex digit.
+     * @return The nibble values, 0 where the character is not a hex digit.
+     */
+    static inline uint8x16_t hexNibbles(uint8x16_t chars, uint8x16_t& valid) {
+        uint8x16_t digit = vsubq_u8(chars, vdupq_n_u8('0'));
+        uint8x16_t isDigit = vcltq_u8(digit, vdupq_n_u8(10));
+        uint8x16_t letter = vsubq_u8(vorrq_u8(chars, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+        uint8x16_t isLetter = vcltq_u8(letter, vdupq_n_u8(6));
+        valid = vandq_u8(valid, vorrq_u8(isDigit, isLetter));
+        return vbslq_u8(isDigit, digit, vandq_u8(isLetter, vaddq_u8(letter, vdupq_n_u8(10))));
+    }
+#endif
+
+    /**
+     * @brief Encode bytes as upper-case hex into preallocated output.
+     * @param The bytes to encode.
+     * @param The number of bytes.
+     * @param Output for size * 2 characters. Must not overlap the input.
+     * @param If true, the bytes are encoded last to first.
+     */
+    void Utils::hexEncode(const char* src, size_t size, char* dst, bool flip) {
+        const u8* in = reinterpret_cast<const u8*>(src);
+        size_t i = 0;
+#if defined(__ARM_NEON)
+        for (; i + 16 <= size; i += 16) {
+            if (flip) {
+                uint8x16_t block = vrev64q_u8(vld1q_u8(in + size - i - 16));
+                hexEncodeBlock(vextq_u8(block, block, 8), dst + (i * 2));
+            } else {
+                hexEncodeBlock(vld1q_u8(in + i), dst + (i * 2));
+            }
+        }
+#endif
+        for (; i < size; ++i) {
+            u8 c = flip ? in[size - 1 - i] : in[i];
+            dst[(i * 2)] = HexDigits[c >> 4];
+            dst[(i * 2) + 1] = HexDigits[c & 0xF];
+        }
+    }
+
+    /**
+     * @brief Decode hex characters into preallocated output. Characters that are not hex digits decode as 0.
+     * @param The hex characters, two per byte.
+     * @param The number of bytes to decode.
+     * @param Output for count bytes.
+     * @return false if any character was not a hex digit.
+     */
+    bool Utils::hexDecode(const char* src, size_t count, char* dst) {
+        u8* out = reinterpret_cast<u8*>(dst);
+        bool valid = true;
+        size_t i = 0;
+#if defined(__ARM_NEON)
+        uint8x16_t lanes = vdupq_n_u8(0xFF);
+        for (; i + 16 <= count; i += 16) {
+            uint8x16x2_t chars = vld2q_u8(reinterpret_cast<const uint8_t*>(src) + (i * 2));
+            uint8x16_t hi = hexNibbles(chars.val[0], lanes);
+            uint8x16_t lo = hexNibbles(chars.val[1], lanes);
+            vst1q_u8(out + i, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+        }
+
+        valid = vminvq_u8(lanes) != 0;
+#endif
+        for (; i < count; ++i) {
+            u8 hi = HexValues[static_cast<u8>(src[(i * 2)])];
+            u8 lo = HexValues[static_cast<u8>(src[(i * 2) + 1])];
+            valid &= hi != 0xFF && lo != 0xFF;
+            out[i] = ((hi != 0xFF ? hi : 0) << 4) | (lo != 0xFF ? lo : 0);
+        }
+
+        return valid;
+    }
+
     /**
      * @brief Handle backwards compatibility for sent data by WiFi.
      * @param Output buffer for result.
@@ -212,27 +421,33 @@ namespace Util {
             return;
         }
 
-        std::vector<char> hexBuffer;
-        hexBuffer.reserve(buffer.size() * 2);
-
-        static const char hexDigits[] = "0123456789ABCDEF";
         size_t n = buffer.size();
-
         if (flip) {
-            for (size_t i = 0; i < n; ++i) {
-                unsigned char c = static_cast<unsigned char>(buffer[n - 1 - i]);
-                hexBuffer.push_back(hexDigits[(c >> 4) & 0xF]);
-                hexBuffer.push_back(hexDigits[c & 0xF]);
-            }
-        } else {
-            for (size_t i = 0; i < n; ++i) {
-                unsigned char c = static_cast<unsigned char>(buffer[i]);
-                hexBuffer.push_back(hexDigits[(c >> 4) & 0xF]);
-                hexBuffer.push_back(hexDigits[c & 0xF]);
-            }
+            std::vector<char> hexBuffer = BufferPool::Pool::instance().acquire(n * 2);
+            hexBuffer.resize(n * 2);
+            hexEncode(buffer.data(), n, hexBuffer.data(), true);
+            buffer.swap(hexBuffer);
+            BufferPool::Pool::instance().release(std::move(hexBuffer));
+            return;
+        }
+
+        // Encode in place from the back, so each output pair only overwrites input that has already been read.
+        buffer.resize(n * 2);
+        char* data = buffer.data();
+        size_t i = n;
+        while (i % 16 != 0) {
+            --i;
+            u8 c = static_cast<u8>(data[i]);
+            data[(i * 2) + 1] = HexDigits[c & 0xF];
+            data[(i * 2)] = HexDigits[c >> 4];
         }
 
-        buffer.swap(hexBuffer);
+        while (i > 0) {
+            i -= 16;
+            char block[16];
+            std::memcpy(block, data + i, sizeof(block));
+            hexEncode(block, sizeof(block), data + (i * 2));
+        }
     }
 
     /**
@@ -246,49 +461,14 @@ namespace Util {
         }
 
         size_t valueSize = buffer.size();
-        char hexStr[17] = { 0 };
-        const char* dataPtr = buffer.data();
-        char temp[8];
-
-        if (flip && valueSize > 1 && valueSize <= 8) {
-            for (size_t i = 0; i < valueSize; ++i) {
-                temp[i] = buffer[valueSize - 1 - i];
-            }
-
-            dataPtr = temp;
-        }
-
-        switch (valueSize) {
-        case 8: {
-            uint64_t value;
-            std::memcpy(&value, dataPtr, 8);
-            std::snprintf(hexStr, sizeof(hexStr), "%016llX", static_cast<unsigned long long>(value));
-            buffer.assign(hexStr, hexStr + 16);
-            break;
-        }
-        case 4: {
-            uint32_t value;
-            std::memcpy(&value, dataPtr, 4);
-            std::snprintf(hexStr, sizeof(hexStr), "%08X", value);
-            buffer.assign(hexStr, hexStr + 8);
-            break;
-        }
-        case 2: {
-            uint16_t value;
-            std::memcpy(&value, dataPtr, 2);
-            std::snprintf(hexStr, sizeof(hexStr), "%04X", value);
-            buffer.assign(hexStr, hexStr + 4);
-            break;
-        }
-        case 1: {
-            uint8_t value = static_cast<uint8_t>(dataPtr[0]);
-            std::snprintf(hexStr, sizeof(hexStr), "%02X", value);
-            buffer.assign(hexStr, hexStr + 2);
-            break;
-        }
-        default:
+        if (valueSize != 1 && valueSize != 2 && valueSize != 4 && valueSize != 8) {
             Logger::instance().log("hexifyString() Unsupported buffer size: " + std::to_string(valueSize), "", true);
-            break;
+            return;
         }
+
+        // Values are little-endian, so printing one most significant digit first means encoding its bytes last to first.
+        char hexStr[16];
+        hexEncode(buffer.data(), valueSize, hexStr, !flip);
+        buffer.assign(hexStr, hexStr + (valueSize * 2));
     }
 }
@@ -0,0 +1,288 @@
+#include "defines.h"
+#include "watchCommands.h"
+#include "util.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+
+namespace WatchCommands {
+    using namespace SbbLog;
+    using namespace Util;
+
+    /**
+     * @brief Start the watch sampler thread.
+     * @param Queue for sending watchChanged messages.
+     * @param Condition variable for the sender queue.
+     * @param Atomic boolean for stopping the thread, passed from the command thread.
+     * @param Atomic boolean for error handling, passed from the command thread.
+     */
+    void Watcher::startWatchThread(LockFreeQueue<std::vector<char>>& senderQueue, std::condition_variable& senderCv, std::atomic_bool& stop, std::atomic_bool& error) {
+        {
+            std::lock_guard<std::mutex> lock(m_watchMutex);
+            if (m_watchThreadRunning) {
+                return;
+            }
+
+            m_watchThreadRunning = true;
+        }
+
+        // A previous sampler exits on its own once the last watch is removed.
+        if (m_watchThread.joinable()) {
+            m_watchThread.join();
+        }
+
+        Logger::instance().log("Starting watchLoop thread.");
+        try {
+            m_watchThread = std::thread(&Watcher::watchLoop, this, std::ref(senderQueue), std::ref(senderCv), std::ref(stop), std::ref(error));
+        } catch (const std::exception& e) {
+            Logger::instance().log("Failed to create watchLoop thread: ", e.what());
+            m_watchThreadRunning = false;
+        } catch (...) {
+            Logger::instance().log("Unknown exception creating watchLoop thread.");
+            m_watchThreadRunning = false;
+        }
+    }
+
+    /**
+     * @brief Check whether watches are registered but the sampler thread isn't running.
+     * @return true if the sampler thread should be started.
+     */
+    bool Watcher::getWatchPending() {
+        std::lock_guard<std::mutex> lock(m_watchMutex);
+        return !m_watchThreadRunning && !m_watches.empty();
+    }
+
+    /**
+     * @brief Wake the watch sampler thread.
+     */
+    void Watcher::watchNotifyAll() {
+        m_watchCv.notify_all();
+    }
+
+    /**
+     * @brief Stop and join the watch sampler thread, and drop every watch.
+     */
+    void Watcher::watchJoinThread() {
+        m_watchStop = true;
+        m_watchCv.notify_all();
+        if (m_watchThread.joinable()) m_watchThread.join();
+
+        std::lock_guard<std::mutex> lock(m_watchMutex);
+        m_watches.clear();
+        m_watchThreadRunning = false;
+        m_watchStop = false;
+    }
+
+    /**
+     * @brief Send each watch's events to the client that registered it rather than to the sender queue.
+     * @param The sink.
+     */
+    void Watcher::watchSetEventSink(EventSink sink) {
+        m_watchEventSink = std::move(sink);
+    }
+
+    /**
+     * @brief Register a watch for the current client, replacing any of its watches with the same id.
+     * @param The watch id reported in watchChanged messages.
+     * @param The address expression, size and poll interval.
+     * @return true if the watch was registered.
+     */
+    bool Watcher::watchAdd(const std::string& id, const WatchSpec& spec) {
+        if (spec.size == 0 || spec.size > WatchMaxSize) {
+            Logger::instance().log("watchAdd() invalid size: " + std::to_string(spec.size));
+            return false;
+        }
+
+        // Checked under the debug mutex, like a debug session, so a request still in flight can't add a watch for a client already gone.
+        std::lock_guard<std::recursive_mutex> debugLock(m_debugMutex);
+        if (clientSettings().closed) {
+            return false;
+        }
+
+        WatchKey key { &clientSettings(), id };
+        std::lock_guard<std::mutex> lock(m_watchMutex);
+        if (m_watches.find(key) == m_watches.end() && m_watches.size() >= WatchCapacity) {
+            Logger::instance().log("watchAdd() too many watches registered.");
+            return false;
+        }
+
+        m_watches[key] = Watch { spec, ++m_watchGeneration, 0, {}, false };
+        m_watchesChanged = true;
+        m_watchCv.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief Remove one of the current client's watches.
+     * @param The watch id.
+     * @return true if the watch existed.
+     */
+    bool Watcher::watchRemove(const std::string& id) {
+        std::lock_guard<std::mutex> lock(m_watchMutex);
+        if (m_watches.erase(WatchKey { &clientSettings(), id }) == 0) {
+            return false;
+        }
+
+        m_watchesChanged = true;
+        m_watchCv.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief Drop every watch the current client registered, when it disconnects. The sampler exits by itself once no watches are left.
+     */
+    void Watcher::watchClear() {
+        const ModuleBase::ClientSettings* owner = &clientSettings();
+        std::lock_guard<std::mutex> lock(m_watchMutex);
+        if (std::erase_if(m_watches, [owner](const auto& entry) { return entry.first.first == owner; }) == 0) {
+            return;
+        }
+
+        m_watchesChanged = true;
+        m_watchCv.notify_all();
+    }
+
+    /**
+     * @brief Parse the base of a watch address expression.
+     * @param The base name: heap, main, absolute or pointer.
+     * @param[out] The parsed base.
+     * @return true if the base is known.
+     */
+    bool Watcher::parseWatchBase(std::string_view arg, WatchBase& base) {
+        if (arg == "heap") {
+            base = WatchBase::Heap;
+        } else if (arg == "main") {
+            base = WatchBase::Main;
+        } else if (arg == "absolute") {
+            base = WatchBase::Absolute;
+        } else if (arg == "pointer") {
+            base = WatchBase::Pointer;
+        } else {
+            Logger::instance().log("parseWatchBase() unknown base (" + std::string(arg) + ").");
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Sampler loop. Reads every due watch under one debug session per tick and pushes a watchChanged message when a value differs from the last sample.
+     * Exits once the last watch is removed, or when the connection stops.
+     * @param Queue for sending data.
+     * @param Condition variable for the sender queue.
+     * @param Atomic boolean for stopping the thread, passed from the command thread.
+     * @param Atomic boolean for error handling, passed from the command thread.
+     */
+    void Watcher::watchLoop(LockFreeQueue<std::vector<char>>& senderQueue, std::condition_variable& senderCv, std::atomic_bool& stop, std::atomic_bool& error) {
+        Logger::instance().log("watchLoop() started.");
+        std::vector<WatchSample> samples;
+        std::unique_lock<std::mutex> lock(m_watchMutex);
+        while (!stop && !error && !m_watchStop && !m_watches.empty()) {
+            u64 now = armGetSystemTick();
+            u64 nextTick = UINT64_MAX;
+            samples.clear();
+            for (auto& [key, watch] : m_watches) {
+                if (watch.nextTick <= now) {
+                    samples.push_back(WatchSample { key, watch.generation, watch.spec, {}, false });
+                    watch.nextTick = now + watch.spec.intervalTicks;
+                }
+
+                nextTick = std::min(nextTick, watch.nextTick);
+            }
+
+            if (!samples.empty()) {
+                // Don't hold the watch list while waiting on the debug handle, so watchAdd/watchRemove never block on a sample.
+                lock.unlock();
+                sampleWatches(samples);
+                lock.lock();
+
+                // Keep streamed responses contiguous; the change is reported on the next tick instead.
+                if (m_responseStreaming) {
+                    continue;
+                }
+
+                for (auto& sample : samples) {
+                    auto it = m_watches.find(sample.key);
+                    if (!sample.valid || it == m_watches.end() || it->second.generation != sample.generation) {
+                        continue;
+                    }
+
+                    Watch& watch = it->second;
+                    if (watch.hasValue && watch.value == sample.value) {
+                        continue;
+                    }
+
+                    bool changed = watch.hasValue;
+                    watch.value = sample.value;
+                    watch.hasValue = true;
+                    if (!changed) {
+                        continue;
+                    }
+
+                    std::vector<char> hex = sample.value;
+                    Utils::hexify(hex);
+                    std::string res = "watchChanged " + sample.key.second + " " + std::string(hex.begin(), hex.end()) + "\r\n";
+                    // The owner's settings stay valid while its watch is registered, and watchClear() needs this lock to remove it.
+                    if (m_watchEventSink) {
+                        if (!m_watchEventSink(*sample.key.first, makeEventMessage(res, *sample.key.first))) {
+                            Logger::instance().log("Client gone or send queue full, dropping watchChanged message.");
+                        }
+                    } else if (!senderQueue.full()) {
+                        senderQueue.push(makeEventMessage(res));
+                        senderCv.notify_one();
+                    } else {
+                        Logger::instance().log("Sender queue full, dropping watchChanged message.");
+                    }
+                }
+
+                continue;
+            }
+
+            m_watchCv.wait_for(lock, std::chrono::nanoseconds(armTicksToNs(nextTick - now)), [&] { return stop || error || m_watchStop || m_watchesChanged; });
+            m_watchesChanged = false;
+        }
+
+        m_watchThreadRunning = false;
+        Logger::instance().log("watchLoop() exiting thread...");
+    }
+
+    /**
+     * @brief Read the due watches, attaching to the application once for all of them.
+     * @param[in,out] The due watches; value and valid are filled in.
+     */
+    void Watcher::sampleWatches(std::vector<WatchSample>& samples) {
+        DebugSession session(*this);
+        u64 pid = 0;
+        Result rc = pmdmntGetApplicationProcessId(&pid);
+        if (R_FAILED(rc)) {
+            invalidateMetaData();
+            return;
+        }
+
+        updateMetaData(pid);
+        for (auto& sample : samples) {
+            u64 address = resolveWatchAddress(sample.spec);
+            sample.valid = address != 0 && R_SUCCEEDED(readRange(address, sample.spec.size, sample.value));
+        }
+    }
+
+    /**
+     * @brief Resolve a watch address expression against the current metadata.
+     * @param The watch.
+     * @return The absolute address, or 0 if a pointer chain couldn't be followed.
+     */
+    u64 Watcher::resolveWatchAddress(const WatchSpec& spec) {
+        switch (spec.base) {
+            case WatchBase::Heap: return m_metaData.heap_base + spec.offset;
+            case WatchBase::Main: return m_metaData.main_nso_base + spec.offset;
+            case WatchBase::Absolute: return spec.offset;
+            case WatchBase::Pointer: {
+                std::vector<char> buffer;
+                u64 address = followMainPointer(spec.mainJump, spec.jumps, buffer);
+                return address != 0 ? address + spec.offset : 0;
+            }
+        }
+
+        return 0;
+    }
+}